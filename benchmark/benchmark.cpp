@@ -0,0 +1,316 @@
+// times the raw limb functions over operand sizes from 1 limb up to --max-size limbs and prints the results as json
+// when built with BIGINT_BENCHMARK_GMP the same operations are timed on the gmp mpn functions, with operands of the
+// same number of bits
+//
+// usage: bigint_benchmark [--max-size limbs] [--min-time seconds] [--operation name] [--no-gmp]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "../bigint.h"
+
+#if defined(BIGINT_BENCHMARK_GMP)
+#include <gmp.h>
+#endif
+
+namespace
+{
+    using bigint::limb_t;
+
+    constexpr int LIMB_BITS = sizeof(limb_t) * 8;
+
+    struct options
+    {
+        int max_size = 1000000;
+        double min_time = 0.05;
+        std::string operation;
+        bool gmp = true;
+    };
+
+    // one row of the output, limbs counts the limbs read by the operation
+    struct result
+    {
+        char const * operation;
+        char const * library;
+        int lhs_size;
+        int rhs_size;
+        double limbs;
+        double ns_per_op;
+        long iterations;
+    };
+
+    std::mt19937_64 g_random(1);
+    std::vector<result> g_results;
+    volatile limb_t g_sink;
+
+    // repeats run until min_time has passed, doubling the batch size to keep the clock out of small operations
+    template <typename F>
+    void measure(options const & opts, char const * operation, char const * library, int lhs_size, int rhs_size, double limbs, F run)
+    {
+        using clock = std::chrono::steady_clock;
+
+        // the first call warms the caches up, it is the measurement when it already takes min_time
+        clock::time_point const first = clock::now();
+        run();
+        double elapsed = std::chrono::duration<double>(clock::now() - first).count();
+        long iterations = 1;
+        long batch = 1;
+
+        if (elapsed < opts.min_time)
+        {
+            elapsed = 0;
+            iterations = 0;
+        }
+        while (elapsed < opts.min_time)
+        {
+            clock::time_point const start = clock::now();
+            for (long i = 0; i < batch; ++i)
+                run();
+            elapsed += std::chrono::duration<double>(clock::now() - start).count();
+            iterations += batch;
+            batch *= 2;
+        }
+        g_results.push_back({ operation, library, lhs_size, rhs_size, limbs, elapsed * 1e9 / iterations, iterations });
+    }
+
+    // random digits whose top limb is not zero
+    std::vector<limb_t> random_digits(int size)
+    {
+        std::vector<limb_t> digits(size);
+        for (limb_t & digit : digits)
+            digit = static_cast<limb_t>(g_random());
+        digits[size - 1] |= static_cast<limb_t>(1) << (LIMB_BITS - 1);
+        return digits;
+    }
+
+    // 1, 2, 5, 10, 20, 50... up to max_size, with the steps around the multiplication thresholds filled in
+    std::vector<int> sizes(int max_size)
+    {
+        std::vector<int> result;
+        for (int scale = 1; scale <= max_size; scale *= 10)
+        {
+            for (int step : { 1, 2, 5 })
+            {
+                if (scale * step <= max_size)
+                    result.push_back(scale * step);
+            }
+        }
+        for (int size : { 16, 24, 32, 40, 48, 64, 150, 300, 400, 800 })
+        {
+            if (size <= max_size)
+                result.push_back(size);
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    bool selected(options const & opts, char const * operation)
+    {
+        return opts.operation.empty() || opts.operation == operation;
+    }
+
+    // characters needed by to_base10 for size limbs, with room for the sign and the terminator
+    int base10_capacity(int size)
+    {
+        return static_cast<int>(std::ceil(size * LIMB_BITS * std::log10(2.0))) + 2;
+    }
+
+    void bench_bigint(options const & opts, int size)
+    {
+        // unbalanced operands have a quarter of the limbs of the other one
+        for (int rhs_size : { size, size / 4 })
+        {
+            if (rhs_size == 0)
+                continue;
+            std::vector<limb_t> const lhs = random_digits(size);
+            std::vector<limb_t> rhs = random_digits(rhs_size);
+            std::vector<limb_t> result(size * 2 + 2);
+            if (rhs_size == size)
+                rhs[size - 1] >>= 1;
+
+            if (selected(opts, "add"))
+                measure(opts, "add", "bigint", size, rhs_size, size + rhs_size, [&] { g_sink = bigint::add(result.data(), lhs.data(), rhs.data(), size, rhs_size); });
+            if (selected(opts, "sub"))
+                measure(opts, "sub", "bigint", size, rhs_size, size + rhs_size, [&] { g_sink = bigint::sub(result.data(), lhs.data(), rhs.data(), size, rhs_size); });
+            if (selected(opts, "mul"))
+                measure(opts, "mul", "bigint", size, rhs_size, size + rhs_size, [&] { g_sink = bigint::mul(result.data(), lhs.data(), rhs.data(), size, rhs_size); });
+        }
+
+        // balanced divisions take a numerator twice as long as the divisor, unbalanced ones four times
+        for (int lhs_size : { size * 2, size * 4 })
+        {
+            std::vector<limb_t> const lhs = random_digits(lhs_size);
+            std::vector<limb_t> const rhs = random_digits(size);
+            std::vector<limb_t> result(lhs_size);
+
+            if (selected(opts, "div"))
+                measure(opts, "div", "bigint", lhs_size, size, lhs_size + size, [&] { g_sink = bigint::div(result.data(), lhs.data(), rhs.data(), lhs_size, size); });
+            if (selected(opts, "mod"))
+                measure(opts, "mod", "bigint", lhs_size, size, lhs_size + size, [&] { g_sink = bigint::mod(result.data(), lhs.data(), rhs.data(), lhs_size, size); });
+        }
+
+        std::vector<limb_t> const digits = random_digits(size);
+        std::vector<limb_t> result(size + 2);
+        std::vector<char> str(base10_capacity(size));
+
+        if (selected(opts, "to_base10"))
+            measure(opts, "to_base10", "bigint", size, 0, size, [&] { g_sink = bigint::to_base10(str.data(), static_cast<int>(str.size()), digits.data(), size); });
+        if (selected(opts, "from_base10"))
+        {
+            int const length = bigint::to_base10(str.data(), static_cast<int>(str.size()), digits.data(), size);
+            measure(opts, "from_base10", "bigint", size, 0, size, [&] { g_sink = bigint::from_base10(result.data(), str.data(), length); });
+        }
+        if (selected(opts, "to_base16"))
+            measure(opts, "to_base16", "bigint", size, 0, size, [&] { g_sink = bigint::to_base16(str.data(), static_cast<int>(str.size()), digits.data(), size); });
+        if (selected(opts, "from_base16"))
+        {
+            int const length = bigint::to_base16(str.data(), static_cast<int>(str.size()), digits.data(), size);
+            measure(opts, "from_base16", "bigint", size, 0, size, [&] { g_sink = bigint::from_base16(result.data(), str.data(), length); });
+        }
+    }
+
+#if defined(BIGINT_BENCHMARK_GMP)
+    // gmp operands of the same number of bits as size bigint limbs, sizes are still reported in bigint limbs
+    std::vector<mp_limb_t> random_gmp_digits(int size)
+    {
+        int const gmp_size = (size * LIMB_BITS + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+        std::vector<mp_limb_t> digits(gmp_size);
+        for (mp_limb_t & digit : digits)
+            digit = static_cast<mp_limb_t>(g_random());
+        int const extra_bits = gmp_size * GMP_NUMB_BITS - size * LIMB_BITS;
+        digits[gmp_size - 1] >>= extra_bits;
+        digits[gmp_size - 1] |= static_cast<mp_limb_t>(1) << ((size * LIMB_BITS - 1) % GMP_NUMB_BITS);
+        return digits;
+    }
+
+    // mpn_set_str takes digit values instead of characters
+    std::vector<unsigned char> gmp_string(std::vector<mp_limb_t> const & digits, int base)
+    {
+        std::vector<mp_limb_t> copy(digits);
+        std::vector<unsigned char> str(digits.size() * GMP_NUMB_BITS / 3 + 2);
+        str.resize(mpn_get_str(str.data(), base, copy.data(), static_cast<mp_size_t>(copy.size())));
+        return str;
+    }
+
+    void bench_gmp(options const & opts, int size)
+    {
+        for (int rhs_size : { size, size / 4 })
+        {
+            if (rhs_size == 0)
+                continue;
+            std::vector<mp_limb_t> const lhs = random_gmp_digits(size);
+            std::vector<mp_limb_t> rhs = random_gmp_digits(rhs_size);
+            mp_size_t const ln = static_cast<mp_size_t>(lhs.size());
+            mp_size_t const rn = static_cast<mp_size_t>(rhs.size());
+            std::vector<mp_limb_t> result(ln + rn + 1);
+            if (rhs_size == size)
+                rhs[rn - 1] >>= 1;
+
+            if (selected(opts, "add"))
+                measure(opts, "add", "gmp", size, rhs_size, size + rhs_size, [&] { g_sink = mpn_add(result.data(), lhs.data(), ln, rhs.data(), rn); });
+            if (selected(opts, "sub"))
+                measure(opts, "sub", "gmp", size, rhs_size, size + rhs_size, [&] { g_sink = mpn_sub(result.data(), lhs.data(), ln, rhs.data(), rn); });
+            if (selected(opts, "mul"))
+                measure(opts, "mul", "gmp", size, rhs_size, size + rhs_size, [&] { g_sink = mpn_mul(result.data(), lhs.data(), ln, rhs.data(), rn); });
+        }
+
+        // mpn_tdiv_qr computes the quotient and the remainder together, div and mod time the same call
+        for (int lhs_size : { size * 2, size * 4 })
+        {
+            std::vector<mp_limb_t> const lhs = random_gmp_digits(lhs_size);
+            std::vector<mp_limb_t> const rhs = random_gmp_digits(size);
+            mp_size_t const ln = static_cast<mp_size_t>(lhs.size());
+            mp_size_t const rn = static_cast<mp_size_t>(rhs.size());
+            std::vector<mp_limb_t> quotient(ln - rn + 1);
+            std::vector<mp_limb_t> remainder(rn);
+
+            for (char const * operation : { "div", "mod" })
+            {
+                if (selected(opts, operation))
+                    measure(opts, operation, "gmp", lhs_size, size, lhs_size + size, [&] { mpn_tdiv_qr(quotient.data(), remainder.data(), 0, lhs.data(), ln, rhs.data(), rn); g_sink = remainder[0]; });
+            }
+        }
+
+        // mpn_get_str destroys its operand, the copy is part of the timed operation
+        std::vector<mp_limb_t> const digits = random_gmp_digits(size);
+        mp_size_t const n = static_cast<mp_size_t>(digits.size());
+        std::vector<mp_limb_t> copy(n);
+        std::vector<mp_limb_t> result(n + 1);
+
+        for (int base : { 10, 16 })
+        {
+            std::vector<unsigned char> const value = gmp_string(digits, base);
+            std::vector<unsigned char> str(value.size() + 1);
+
+            if (selected(opts, base == 10 ? "to_base10" : "to_base16"))
+            {
+                measure(opts, base == 10 ? "to_base10" : "to_base16", "gmp", size, 0, size, [&] {
+                    std::copy(digits.begin(), digits.end(), copy.begin());
+                    g_sink = mpn_get_str(str.data(), base, copy.data(), n);
+                });
+            }
+            if (selected(opts, base == 10 ? "from_base10" : "from_base16"))
+                measure(opts, base == 10 ? "from_base10" : "from_base16", "gmp", size, 0, size, [&] { g_sink = mpn_set_str(result.data(), value.data(), value.size(), base); });
+        }
+    }
+#endif
+
+    bool parse(options & opts, int argc, char ** argv)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string const arg = argv[i];
+            if (arg == "--no-gmp")
+                opts.gmp = false;
+            else if (arg == "--max-size" && i + 1 < argc)
+                opts.max_size = std::atoi(argv[++i]);
+            else if (arg == "--min-time" && i + 1 < argc)
+                opts.min_time = std::atof(argv[++i]);
+            else if (arg == "--operation" && i + 1 < argc)
+                opts.operation = argv[++i];
+            else
+                return false;
+        }
+        return opts.max_size >= 1;
+    }
+
+    void print()
+    {
+        std::printf("{\n  \"limb_bits\": %d,\n  \"results\": [", LIMB_BITS);
+        for (size_t i = 0; i < g_results.size(); ++i)
+        {
+            result const & r = g_results[i];
+            std::printf("%s\n    { \"operation\": \"%s\", \"library\": \"%s\", \"lhs_size\": %d, \"rhs_size\": %d, \"ns_per_op\": %.1f, \"limbs_per_second\": %.4g, \"iterations\": %ld }",
+                i == 0 ? "" : ",", r.operation, r.library, r.lhs_size, r.rhs_size, r.ns_per_op, r.limbs * 1e9 / r.ns_per_op, r.iterations);
+        }
+        std::printf("\n  ]\n}\n");
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    options opts;
+    if (!parse(opts, argc, argv))
+    {
+        std::fprintf(stderr, "usage: %s [--max-size limbs] [--min-time seconds] [--operation name] [--no-gmp]\n", argv[0]);
+        return 1;
+    }
+
+    for (int size : sizes(opts.max_size))
+    {
+        bench_bigint(opts, size);
+#if defined(BIGINT_BENCHMARK_GMP)
+        if (opts.gmp)
+            bench_gmp(opts, size);
+#endif
+        std::fprintf(stderr, "%d limbs done\n", size);
+    }
+    print();
+    return 0;
+}
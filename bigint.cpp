@@ -1,10 +1,46 @@
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <condition_variable>
 #include <cstdlib>
-#include <type_traits>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "bigint.h"
 
+// x86-64 kernels are compiled with target attributes and selected at runtime, define BIGINT_NO_SIMD to disable them
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(BIGINT_NO_SIMD)
+#define BIGINT_X86_SIMD
+#include <immintrin.h>
+#endif
+
 static constexpr int KARATSUBA_THRESHOLD = 30;
+static constexpr int KARATSUBA_SQUARING_THRESHOLD = 40;
+static constexpr int TOOM3_THRESHOLD = 200;
+static constexpr int TOOM4_THRESHOLD = 600;
+// every 64-bit limb is two ntt coefficients, which moves the crossover with toom4 much higher
+#if defined(BIGINT_LIMB_64)
+static constexpr int NTT_THRESHOLD = 60000;
+#else
+static constexpr int NTT_THRESHOLD = 3000;
+#endif
+static constexpr int DEFAULT_PARALLEL_GRAIN_SIZE = 1000;
+static constexpr int SCRATCH_CHUNK_SIZE = 4096;
+static constexpr int TO_BASE10_THRESHOLD = 30;
+static constexpr int FROM_BASE10_THRESHOLD = 30;
+static constexpr int BURNIKEL_ZIEGLER_THRESHOLD = 60;
+static constexpr int NEWTON_RECIPROCAL_THRESHOLD = 150;
+static constexpr int NEWTON_DIVISION_THRESHOLD = 30000;
+static constexpr int BARRETT_REDUCTION_THRESHOLD = 40;
+static constexpr int LIMB_DIVISOR_THRESHOLD = 3;
+static constexpr int HALF_GCD_THRESHOLD = 150;
+static constexpr int SUBQUADRATIC_GCD_THRESHOLD = 1500;
+static constexpr int PRODUCT_TREE_THRESHOLD = 20;
 
 // https://graphics.stanford.edu/~seander/bithacks.html
 static ::uint32_t de_bruijn(::uint32_t n)
@@ -22,34 +58,498 @@ static ::uint32_t de_bruijn(::uint32_t n)
     return multiply_de_bruijn_bit_position[(n * 0x07C4ACDDU) >> 27];
 }
 
+#if defined(BIGINT_LIMB_64)
+static ::uint32_t de_bruijn(::uint64_t n)
+{
+    ::uint32_t const high = static_cast<::uint32_t>(n >> 32);
+    if (high != 0)
+        return de_bruijn(high) + 32;
+    return de_bruijn(static_cast<::uint32_t>(n));
+}
+#endif
+
 namespace bigint
 {
+#if defined(BIGINT_LIMB_64)
+    using limb_signed_double_t = __int128;
+#else
+    using limb_signed_double_t = ::int64_t;
+#endif
+
     static limb_t g_zero = 0;
     static void * (*g_allocate)(size_t) = ::malloc;
     static void (*g_deallocate)(void *) = ::free;
 
+    // chunks are never moved, the limbs follow the header and base is the position of the first one in the scratch
+    struct scratch::chunk
+    {
+        chunk * previous;
+        chunk * next;
+        size_t base;
+        size_t capacity;
+        void (*deallocate)(void *);
+
+        limb_t * limbs()
+        {
+            return reinterpret_cast<limb_t *>(this + 1);
+        }
+    };
+
+    // used by the functions not taking a scratch, workers get their own one instead of sharing the caller's
+    static scratch & thread_scratch()
+    {
+        static thread_local scratch workspace;
+        return workspace;
+    }
+
+    // fork/join unit of work, the thread forking it must join it before it goes out of scope
+    struct task
+    {
+        void (*run)(void *);
+        void * argument;
+        std::atomic<bool> done;
+    };
+
+    // index of the deque owned by the current thread, threads outside of the pool share the first one
+    static thread_local int t_task_queue = 0;
+
+    // work stealing pool: every thread pushes and pops its own tasks at the back of its deque while idle
+    // threads steal from the front of the others, a thread waiting for a task runs other tasks meanwhile
+    class task_pool
+    {
+    public:
+        explicit task_pool(int thread_count)
+            : m_queues(thread_count)
+            , m_pending(0)
+            , m_stop(false)
+        {
+            for (int i = 1; i < thread_count; ++i)
+                m_threads.emplace_back(&task_pool::work, this, i);
+        }
+
+        ~task_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (std::thread & thread : m_threads)
+                thread.join();
+        }
+
+        void fork(task * t)
+        {
+            t->done.store(false, std::memory_order_relaxed);
+            queue & own = m_queues[t_task_queue];
+            {
+                std::lock_guard<std::mutex> lock(own.mutex);
+                own.tasks.push_back(t);
+            }
+            m_pending.fetch_add(1);
+            {
+                // a worker checking m_pending under the lock either sees the new task or is already waiting
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            }
+            m_wake.notify_one();
+        }
+
+        void join(task * t)
+        {
+            while (!t->done.load(std::memory_order_acquire))
+            {
+                if (!run_one())
+                    std::this_thread::yield();
+            }
+        }
+
+    private:
+        struct queue
+        {
+            std::mutex mutex;
+            std::deque<task *> tasks;
+        };
+
+        bool run_one()
+        {
+            int const count = static_cast<int>(m_queues.size());
+            task * t = nullptr;
+            {
+                queue & own = m_queues[t_task_queue];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty())
+                {
+                    t = own.tasks.back();
+                    own.tasks.pop_back();
+                }
+            }
+            for (int i = 1; t == nullptr && i < count; ++i)
+            {
+                queue & victim = m_queues[(t_task_queue + i) % count];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty())
+                {
+                    t = victim.tasks.front();
+                    victim.tasks.pop_front();
+                }
+            }
+            if (t == nullptr)
+                return false;
+            m_pending.fetch_sub(1);
+            t->run(t->argument);
+            t->done.store(true, std::memory_order_release);
+            return true;
+        }
+
+        void work(int index)
+        {
+            t_task_queue = index;
+            for (;;)
+            {
+                if (run_one())
+                    continue;
+                std::unique_lock<std::mutex> lock(m_sleep_mutex);
+                m_wake.wait(lock, [this] { return m_stop || m_pending.load() > 0; });
+                if (m_stop)
+                    return;
+            }
+        }
+
+        std::vector<queue> m_queues;
+        std::vector<std::thread> m_threads;
+        std::atomic<int> m_pending;
+        std::mutex m_sleep_mutex;
+        std::condition_variable m_wake;
+        bool m_stop;
+    };
+
+    static std::unique_ptr<task_pool> g_task_pool;
+    static int g_parallel_grain_size = DEFAULT_PARALLEL_GRAIN_SIZE;
+
     static int mul_with_scratch_memory(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * memory);
+    static int sqr_with_scratch_memory(limb_t * result, limb_t const * digits, int size, limb_t * memory);
 
-    static int long_multiplication(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    // scratch memory needed by mul_with_scratch_memory, every tier needs less than 8 * max(lhs_size, rhs_size)
+    // as long as TOOM4_THRESHOLD is above 68: karatsuba needs 4 * (h + 1) + S(h + 1) with h = ceil(m / 2),
+    // toom3 12 * (k + 1) + S(k + 1) with k = ceil(m / 3) and toom4 21 * (k + 1) + S(k + 1) with k = ceil(m / 4)
+    // ntt needs 4.5 words per coefficient of a transform at most twice as long as the result, which is below
+    // 18 * m, so 20 * m also covers the other tiers once operands can reach the ntt tier
+    static int mul_scratch_size(int lhs_size, int rhs_size)
     {
-        constexpr limb_double_t base = static_cast<limb_double_t>(1) << (sizeof(limb_t) * 8);
+        static_assert(TOOM4_THRESHOLD > 68 && TOOM4_THRESHOLD > TOOM3_THRESHOLD, "mul_scratch_size bound relies on the toom thresholds");
+        int const size = std::max(lhs_size, rhs_size);
+        // in step with the ntt switch of mul_with_scratch_memory and sqr_with_scratch_memory
+        return size > NTT_THRESHOLD ? size * 20 : size * 8;
+    }
 
-        for (int i = 0; i < (lhs_size + rhs_size); ++i)
-            result[i] = 0;
+    static bool parallel(int size)
+    {
+        return g_task_pool != nullptr && size >= g_parallel_grain_size;
+    }
 
-        for (int i = 0; i < lhs_size; ++i)
+    struct sub_product
+    {
+        limb_t * result;
+        limb_t const * lhs;
+        limb_t const * rhs;
+        int lhs_size;
+        int rhs_size;
+        int result_size;
+    };
+
+    static void run_product(void * argument)
+    {
+        sub_product * const p = static_cast<sub_product *>(argument);
+        p->result_size = mul(p->result, p->lhs, p->rhs, p->lhs_size, p->rhs_size);
+    }
+
+    // computes independent products writing to disjoint memory, forking all of them but the first one on the task pool
+    // when the first one is big enough, forked products allocate their own scratch memory
+    static void multiply_all(sub_product * products, int count, limb_t * memory)
+    {
+        if (parallel(std::min(products[0].lhs_size, products[0].rhs_size)))
         {
-            limb_t carry = 0;
-            for (int j = 0; j < rhs_size; ++j)
+            task tasks[8];
+            assert(count <= 8);
+            for (int i = 1; i < count; ++i)
             {
-                limb_double_t product = static_cast<limb_double_t>(result[i + j]);
-                product += carry;
-                product += static_cast<limb_double_t>(lhs[i]) * rhs[j];
-                carry = static_cast<limb_t>(product / base);
-                result[i + j] = product % base;
+                tasks[i].run = &run_product;
+                tasks[i].argument = &products[i];
+                g_task_pool->fork(&tasks[i]);
             }
-            result[i + rhs_size] = carry;
+            products[0].result_size = mul_with_scratch_memory(products[0].result, products[0].lhs, products[0].rhs, products[0].lhs_size, products[0].rhs_size, memory);
+            for (int i = count - 1; i > 0; --i)
+                g_task_pool->join(&tasks[i]);
+        }
+        else
+        {
+            for (int i = 0; i < count; ++i)
+                products[i].result_size = mul_with_scratch_memory(products[i].result, products[i].lhs, products[i].rhs, products[i].lhs_size, products[i].rhs_size, memory);
+        }
+    }
+
+    static int trimmed_size(limb_t const * digits, int size)
+    {
+        while (size > 1 && digits[size - 1] == 0)
+            size--;
+        return size;
+    }
+
+    // result capacity must be at least size + 1, factor must be greater than zero
+    static int mul_by_one_digit(limb_t * result, limb_t const * digits, int size, limb_t factor)
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        limb_t carry = 0;
+
+        for (int i = 0; i < size; ++i)
+        {
+            limb_double_t const product = static_cast<limb_double_t>(digits[i]) * factor + carry;
+            result[i] = static_cast<limb_t>(product);
+            carry = static_cast<limb_t>(product >> limb_bits);
+        }
+        if (carry > 0)
+            result[size++] = carry;
+        return size;
+    }
+
+    // computes lhs - rhs * factor, which must not be negative
+    static int sub_mul_by_one_digit(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t factor)
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        assert(lhs_size >= rhs_size);
+        limb_t borrow = 0;
+        int i = 0;
+
+        for (; i < rhs_size; ++i)
+        {
+            limb_double_t const product = static_cast<limb_double_t>(rhs[i]) * factor + borrow;
+            limb_t const low = static_cast<limb_t>(product);
+            limb_t const digit = lhs[i];
+            borrow = static_cast<limb_t>(product >> limb_bits) + (digit < low ? 1 : 0);
+            result[i] = digit - low;
+        }
+        for (; i < lhs_size; ++i)
+        {
+            limb_t const digit = lhs[i];
+            result[i] = digit - borrow;
+            borrow = (digit < borrow) ? 1 : 0;
+        }
+        assert(borrow == 0);
+        return trimmed_size(result, lhs_size);
+    }
+
+    // digits must be a multiple of divisor, which must be odd
+    static int divexact_by_one_digit(limb_t * result, limb_t const * digits, int size, limb_t divisor)
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        assert((divisor & 1) == 1);
+
+        // newton iteration on the inverse of divisor modulo 2^limb_bits, d * d == 1 (mod 8) gives the first 3 bits
+        limb_t inverse = divisor;
+        for (int i = 0; i < 5; ++i)
+            inverse *= 2 - divisor * inverse;
+
+        limb_t borrow = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            limb_t const digit = digits[i];
+            limb_t const quotient_digit = (digit - borrow) * inverse;
+            limb_t const underflow = (digit < borrow) ? 1 : 0;
+            result[i] = quotient_digit;
+            borrow = static_cast<limb_t>((static_cast<limb_double_t>(quotient_digit) * divisor) >> limb_bits) + underflow;
+        }
+        return trimmed_size(result, size);
+    }
+
+    // 0 <= bits < limb bits, result can be digits, returns the size of the result
+    static int shift_right(limb_t * result, limb_t const * digits, int size, int bits)
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+
+        for (int i = 0; i < size - 1; ++i)
+            result[i] = (digits[i] >> bits) | static_cast<limb_t>(static_cast<limb_double_t>(digits[i + 1]) << (limb_bits - bits));
+        result[size - 1] = digits[size - 1] >> bits;
+        return trimmed_size(result, size);
+    }
+
+    // 0 <= bits < limb bits, result can be digits or start above it, returns the bits shifted out of the last limb
+    static limb_t shift_left(limb_t * result, limb_t const * digits, int size, int bits)
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        limb_t const high = static_cast<limb_t>(static_cast<limb_double_t>(digits[size - 1]) >> (limb_bits - bits));
+
+        for (int i = size - 1; i > 0; i--)
+            result[i] = (digits[i] << bits) | static_cast<limb_t>(static_cast<limb_double_t>(digits[i - 1]) >> (limb_bits - bits));
+        result[0] = digits[0] << bits;
+        return high;
+    }
+
+    // adds size limbs of lhs and rhs, returns the carry out of the last one
+    static limb_t add_limbs(limb_t * result, limb_t const * lhs, limb_t const * rhs, int size)
+    {
+#if defined(BIGINT_X86_SIMD)
+        // adc is part of the x86-64 baseline, the intrinsic keeps the carry in the flags across limbs
+        unsigned char carry = 0;
+        for (int i = 0; i < size; ++i)
+        {
+#if defined(BIGINT_LIMB_64)
+            unsigned long long digit;
+            carry = _addcarry_u64(carry, lhs[i], rhs[i], &digit);
+#else
+            unsigned int digit;
+            carry = _addcarry_u32(carry, lhs[i], rhs[i], &digit);
+#endif
+            result[i] = digit;
+        }
+        return carry;
+#else
+        limb_t carry = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            limb_t digit = lhs[i];
+            digit += carry;
+            carry = (digit < carry) ? 1 : 0;
+            digit += rhs[i];
+            carry = (digit < rhs[i]) ? 1 : carry;
+            result[i] = digit;
+        }
+        return carry;
+#endif
+    }
+
+    // subtracts size limbs of rhs from lhs, returns the borrow out of the last one
+    static limb_t sub_limbs(limb_t * result, limb_t const * lhs, limb_t const * rhs, int size)
+    {
+#if defined(BIGINT_X86_SIMD)
+        unsigned char borrow = 0;
+        for (int i = 0; i < size; ++i)
+        {
+#if defined(BIGINT_LIMB_64)
+            unsigned long long digit;
+            borrow = _subborrow_u64(borrow, lhs[i], rhs[i], &digit);
+#else
+            unsigned int digit;
+            borrow = _subborrow_u32(borrow, lhs[i], rhs[i], &digit);
+#endif
+            result[i] = digit;
+        }
+        return borrow;
+#else
+        limb_t borrow = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            limb_t digit = lhs[i];
+            digit -= borrow;
+            borrow = (digit > lhs[i]) ? 1 : 0;
+            limb_t const prev = digit;
+            digit -= rhs[i];
+            borrow = (digit > prev) ? 1 : borrow;
+            result[i] = digit;
+        }
+        return borrow;
+#endif
+    }
+
+    // result[0, size) += digits[0, size) * factor, returns the carry limb
+    static limb_t addmul_row_scalar(limb_t * result, limb_t const * digits, int size, limb_t factor)
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        limb_t carry = 0;
+
+        for (int i = 0; i < size; ++i)
+        {
+            limb_double_t const product = static_cast<limb_double_t>(digits[i]) * factor + result[i] + carry;
+            result[i] = static_cast<limb_t>(product);
+            carry = static_cast<limb_t>(product >> limb_bits);
         }
+        return carry;
+    }
+
+#if defined(BIGINT_X86_SIMD) && defined(BIGINT_LIMB_64)
+    // one limb of the row: mulx leaves the flags alone, adcx adds the previous high half on the carry flag
+    // and adox adds the result limb on the overflow flag, so the two carry chains do not wait on each other
+#define BIGINT_ADDMUL_STEP(offset) \
+        "mulxq " offset "(%[digits]), %[low], %[high]\n\t" \
+        "adcxq %[carry], %[low]\n\t" \
+        "adoxq " offset "(%[result]), %[low]\n\t" \
+        "movq %[low], " offset "(%[result])\n\t" \
+        "movq %[high], %[carry]\n\t"
+
+    // loops count on rcx with lea and jrcxz, which leave both carry chains untouched, size % 4 single limbs
+    // go first and the rest four at a time
+    __attribute__((target("adx,bmi2")))
+    static limb_t addmul_row_adx(limb_t * result, limb_t const * digits, int size, limb_t factor)
+    {
+        limb_t carry = 0;
+        limb_t low;
+        limb_t high;
+        long count = size & 3;
+
+        __asm__(
+            "xorl %k[low], %k[low]\n\t"
+            "jrcxz 2f\n"
+            "1:\n\t"
+            BIGINT_ADDMUL_STEP("0")
+            "leaq 8(%[digits]), %[digits]\n\t"
+            "leaq 8(%[result]), %[result]\n\t"
+            "leaq -1(%%rcx), %%rcx\n\t"
+            "jrcxz 2f\n\t"
+            "jmp 1b\n"
+            "2:\n\t"
+            "movq %[blocks], %%rcx\n\t"
+            "jrcxz 4f\n"
+            "3:\n\t"
+            BIGINT_ADDMUL_STEP("0")
+            BIGINT_ADDMUL_STEP("8")
+            BIGINT_ADDMUL_STEP("16")
+            BIGINT_ADDMUL_STEP("24")
+            "leaq 32(%[digits]), %[digits]\n\t"
+            "leaq 32(%[result]), %[result]\n\t"
+            "leaq -1(%%rcx), %%rcx\n\t"
+            "jrcxz 4f\n\t"
+            "jmp 3b\n"
+            "4:\n\t"
+            "movl $0, %k[low]\n\t"
+            "adcxq %[low], %[carry]\n\t"
+            "adoxq %[low], %[carry]\n\t"
+            : [result] "+r"(result), [digits] "+r"(digits), "+c"(count), [carry] "+r"(carry), [low] "=&r"(low), [high] "=&r"(high)
+            : "d"(factor), [blocks] "r"(static_cast<long>(size >> 2))
+            : "cc", "memory");
+        return carry;
+    }
+
+#undef BIGINT_ADDMUL_STEP
+#endif
+
+    struct mul_kernels
+    {
+        limb_t (*addmul_row)(limb_t * result, limb_t const * digits, int size, limb_t factor);
+    };
+
+    static mul_kernels select_mul_kernels()
+    {
+#if defined(BIGINT_X86_SIMD) && defined(BIGINT_LIMB_64)
+        if (__builtin_cpu_supports("adx") && __builtin_cpu_supports("bmi2"))
+            return { addmul_row_adx };
+#endif
+        return { addmul_row_scalar };
+    }
+
+    static mul_kernels const & get_mul_kernels()
+    {
+        static mul_kernels const kernels = select_mul_kernels();
+        return kernels;
+    }
+
+    static int long_multiplication(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        limb_t (*const addmul_row)(limb_t *, limb_t const *, int, limb_t) = get_mul_kernels().addmul_row;
+
+        for (int i = 0; i < rhs_size; ++i)
+            result[i] = 0;
+
+        for (int i = 0; i < lhs_size; ++i)
+            result[i + rhs_size] = addmul_row(result + i, rhs, rhs_size, lhs[i]);
         return result[lhs_size + rhs_size - 1] == 0 ? lhs_size + rhs_size - 1 : lhs_size + rhs_size;
     }
 
@@ -82,23 +582,30 @@ namespace bigint
         else
             high2 = rhs + m2;
 
-        limb_t * const z1_lhs = result;
-        limb_t * const z1_rhs = result + m2 + 2;
+        // z1 operands live in memory so that the three products are independent
+        int const h = m - m2;
+        limb_t * const z1_lhs = memory;
+        limb_t * const z1_rhs = memory + h + 1;
         int const z1_lhs_size = add(z1_lhs, low1, high1, low1_size, high1_size);
-        assert(z1_lhs_size <= (m2 + 2));
+        assert(z1_lhs_size <= (h + 1));
         int const z1_rhs_size = add(z1_rhs, low2, high2, low2_size, high2_size);
-        assert((m2 + 2 + z1_rhs_size) <= (lhs_size + rhs_size));
-
-        limb_t * const z1 = memory;
-        int z1_size = mul_with_scratch_memory(z1, z1_lhs, z1_rhs, z1_lhs_size, z1_rhs_size, memory + z1_lhs_size + z1_rhs_size);
-        memory += z1_size;
+        assert(z1_rhs_size <= (h + 1));
 
+        limb_t * const z1 = memory + (h + 1) * 2;
         limb_t * const z0 = result;
         limb_t * const z2 = result + m2 * 2;
 
-        int const z0_size = mul_with_scratch_memory(z0, low1, low2, low1_size, low2_size, memory);
+        sub_product products[] =
+        {
+            { z1, z1_lhs, z1_rhs, z1_lhs_size, z1_rhs_size, 0 },
+            { z0, low1, low2, low1_size, low2_size, 0 },
+            { z2, high1, high2, high1_size, high2_size, 0 },
+        };
+        multiply_all(products, 3, z1 + (h + 1) * 2);
+        int z1_size = products[0].result_size;
+        int const z0_size = products[1].result_size;
         assert(z0_size <= (m2 * 2));
-        int const z2_size = mul_with_scratch_memory(z2, high1, high2, high1_size, high2_size, memory);
+        int const z2_size = products[2].result_size;
 
         z1_size = sub(z1, z1, z2, z1_size, z2_size);
         z1_size = sub(z1, z1, z0, z1_size, z0_size);
@@ -113,495 +620,3621 @@ namespace bigint
         assert(result_size <= (lhs_size + rhs_size));
         if (!(z1_size == 1 && z1[0] == 0))
         {
+            // z0 may be shorter than m2 when z2 is zero
+            while (result_size < m2)
+                result[result_size++] = 0;
             result_size = add(result + m2, result + m2, z1, result_size - m2, z1_size) + m2;
         }
 
         return result_size;
     }
 
-    static int mul_with_scratch_memory(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * memory)
+    static int long_squaring(limb_t * result, limb_t const * digits, int size)
     {
-        if ((lhs_size == 1 && *lhs == 0) || (rhs_size == 1 && *rhs == 0))
-        {
-            *result = 0;
-            return 1;
-        }
-        if (lhs_size == 1 && rhs_size == 1)
-        {
-            limb_double_t const product = static_cast<limb_double_t>(*lhs) * static_cast<limb_double_t>(*rhs);
-            result[0] = static_cast<limb_t>(product);
-            result[1] = static_cast<limb_t>(product >> (sizeof(limb_t) * 8));
-            return result[1] == 0 ? 1 : 2;
-        }
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        limb_t (*const addmul_row)(limb_t *, limb_t const *, int, limb_t) = get_mul_kernels().addmul_row;
 
-        if (lhs_size > KARATSUBA_THRESHOLD && rhs_size > KARATSUBA_THRESHOLD)
+        for (int i = 0; i < size * 2; ++i)
+            result[i] = 0;
+
+        // off-diagonal products, each one is computed once
+        for (int i = 0; i < size - 1; ++i)
+            result[i + size] = addmul_row(result + i * 2 + 1, digits + i + 1, size - i - 1, digits[i]);
+
+        // double them and add the diagonal squares
+        limb_t shifted_out = 0;
+        limb_t carry = 0;
+        for (int i = 0; i < size; ++i)
         {
-            return karatsuba(result, lhs, rhs, lhs_size, rhs_size, memory);
+            limb_double_t const square = static_cast<limb_double_t>(digits[i]) * digits[i];
+            limb_t const low = result[i * 2];
+            limb_t const high = result[i * 2 + 1];
+            limb_double_t sum = static_cast<limb_double_t>((low << 1) | shifted_out) + static_cast<limb_t>(square) + carry;
+            result[i * 2] = static_cast<limb_t>(sum);
+            sum = static_cast<limb_double_t>((high << 1) | (low >> (limb_bits - 1))) + static_cast<limb_t>(square >> limb_bits) + (sum >> limb_bits);
+            result[i * 2 + 1] = static_cast<limb_t>(sum);
+            carry = static_cast<limb_t>(sum >> limb_bits);
+            shifted_out = high >> (limb_bits - 1);
         }
-        return long_multiplication(result, lhs, rhs, lhs_size, rhs_size);
+        assert(carry == 0 && shifted_out == 0);
+        return trimmed_size(result, size * 2);
     }
 
-    // https://skanthak.hier-im-netz.de/division.html
-    template <bool ignore_quotient, bool ignore_remainder>
-    static int algorithm_d(limb_t * quotient, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * remainder, int * remainder_size)
+    static int karatsuba_squaring(limb_t * result, limb_t const * digits, int size, limb_t * memory)
     {
-        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
-        constexpr limb_double_t base = static_cast<limb_double_t>(1) << (sizeof(limb_t) * 8);
-
-        /* Normalize by shifting rhs left just enough so that its high-order
-        bit is on, and shift lhs left the same amount. We may have to append a
-        high-order digit on the dividend; we do that unconditionally. */
-
-        limb_t const shift = limb_bits - de_bruijn(rhs[rhs_size - 1]) - 1;
-        limb_t * const rhs_normalized = static_cast<limb_t *>(g_allocate(sizeof(limb_t) * rhs_size));
-        for (int i = rhs_size - 1; i > 0; i--)
-            rhs_normalized[i] = (rhs[i] << shift) | (static_cast<limb_double_t>(rhs[i - 1]) >> (limb_bits - shift));
-        rhs_normalized[0] = rhs[0] << shift;
+        int const m2 = size / 2;
 
-        limb_t * const lhs_normalized = static_cast<limb_t *>(g_allocate(sizeof(limb_t) * (lhs_size + 1)));
-        lhs_normalized[lhs_size] = static_cast<limb_double_t>(lhs[lhs_size - 1]) >> (limb_bits - shift);
-        for (int i = lhs_size - 1; i > 0; i--)
-            lhs_normalized[i] = (lhs[i] << shift) | (static_cast<limb_double_t>(lhs[i - 1]) >> (limb_bits - shift));
-        lhs_normalized[0] = lhs[0] << shift;
+        limb_t const * const low = digits;
+        limb_t const * const high = digits + m2;
+        int const low_size = trimmed_size(low, m2);
+        int const high_size = size - m2;
 
-        for (int j = lhs_size - rhs_size; j >= 0; j--) {
-            // Compute estimate quotient_digit of quotient[j].
-            limb_double_t quotient_digit = (lhs_normalized[j + rhs_size] * base + lhs_normalized[j + rhs_size - 1]) / rhs_normalized[rhs_size - 1];
-            limb_double_t remainder_digit = (lhs_normalized[j + rhs_size] * base + lhs_normalized[j + rhs_size - 1]) % rhs_normalized[rhs_size - 1];
+        limb_t * const z1_digits = memory;
+        int const z1_digits_size = add(z1_digits, low, high, low_size, high_size);
 
-            while (quotient_digit >= base || static_cast<limb_t>(quotient_digit) * static_cast<limb_double_t>(rhs_normalized[rhs_size - 2]) > base * remainder_digit + lhs_normalized[j + rhs_size - 2])
-            {
-                quotient_digit = quotient_digit - 1;
-                remainder_digit = remainder_digit + rhs_normalized[rhs_size - 1];
-                if (remainder_digit >= base)
-                {
-                    break;
-                }
-            }
+        limb_t * const z1 = memory + high_size + 1;
+        limb_t * const z0 = result;
+        limb_t * const z2 = result + m2 * 2;
 
-            // Multiply and subtract.
-            typename std::make_signed<limb_double_t>::type diff = 0;
-            typename std::make_signed<limb_double_t>::type sum;
-            for (int i = 0; i < rhs_size; i++) {
-                limb_double_t const product = static_cast<limb_t>(quotient_digit) * static_cast<limb_double_t>(rhs_normalized[i]);
-                sum = lhs_normalized[i + j] - diff - (product & (base - 1));
-                lhs_normalized[i + j] = static_cast<limb_t>(sum);
-                diff = (product >> limb_bits) - (sum >> limb_bits);
-            }
-            sum = lhs_normalized[j + rhs_size] - diff;
-            lhs_normalized[j + rhs_size] = static_cast<limb_t>(sum);
+        sub_product products[] =
+        {
+            { z1, z1_digits, z1_digits, z1_digits_size, z1_digits_size, 0 },
+            { z0, low, low, low_size, low_size, 0 },
+            { z2, high, high, high_size, high_size, 0 },
+        };
+        multiply_all(products, 3, z1 + (high_size + 1) * 2);
+        int z1_size = products[0].result_size;
+        int const z0_size = products[1].result_size;
+        int const z2_size = products[2].result_size;
 
-            if (!ignore_quotient)
-                quotient[j] = static_cast<limb_t>(quotient_digit);
+        z1_size = sub(z1, z1, z2, z1_size, z2_size);
+        z1_size = sub(z1, z1, z0, z1_size, z0_size);
 
-            // If we subtracted too much, add back
-            if (sum < 0) {
-                if (!ignore_quotient)
-                    quotient[j] = quotient[j] - 1;
-                diff = 0;
-                for (int i = 0; i < rhs_size; i++) {
-                    sum = static_cast<limb_double_t>(lhs_normalized[i + j]) + rhs_normalized[i] + diff;
-                    lhs_normalized[i + j] = static_cast<limb_t>(sum);
-                    diff = sum >> limb_bits;
-                }
-                lhs_normalized[j + rhs_size] += static_cast<limb_t>(diff);
-            }
-        }
+        for (int i = z0_size; i < m2 * 2; ++i)
+            result[i] = 0;
+        int const result_size = m2 * 2 + z2_size;
+        add(result + m2, result + m2, z1, result_size - m2, z1_size);
+        return trimmed_size(result, result_size);
+    }
 
-        // If the caller wants the remainder, unnormalize it and pass it back.
-        if (!ignore_remainder) {
-            for (int i = 0; i < rhs_size - 1; i++)
-                remainder[i] = (lhs_normalized[i] >> shift) | (static_cast<limb_double_t>(lhs_normalized[i + 1]) << (limb_bits - shift));
-            remainder[rhs_size - 1] = lhs_normalized[rhs_size - 1] >> shift;
-            *remainder_size = rhs_size;
-            while (*remainder_size > 1 && remainder[*remainder_size - 1] == 0)
-                (*remainder_size)--;
-        }
-        g_deallocate(lhs_normalized);
-        g_deallocate(rhs_normalized);
-        if (!ignore_quotient)
-        {
-            int quotient_size = lhs_size - rhs_size + 1;
-            if (quotient[quotient_size - 1] == 0 && quotient_size > 1)
-                quotient_size--;
-            return quotient_size;
-        }
-        return 0;
+    // sum = even + odd, difference = |even - odd|, returns true if even - odd is negative
+    // sum may be the same as even
+    static bool toom_evaluate_pm(limb_t * sum, int * sum_size, limb_t * difference, int * difference_size, limb_t const * even, int even_size, limb_t const * odd, int odd_size)
+    {
+        bool const negative = compare(even, odd, even_size, odd_size) < 0;
+        if (negative)
+            *difference_size = sub(difference, odd, even, odd_size, even_size);
+        else
+            *difference_size = sub(difference, even, odd, even_size, odd_size);
+        *sum_size = add(sum, even, odd, even_size, odd_size);
+        return negative;
     }
 
-    static int divide_by_one_digit(limb_t * quotient, limb_t const * lhs, limb_t rhs, int lhs_size, limb_t * remainder)
+    // turns plus = v(x) and minus = v(-x) into the sum of the even and the odd coefficients:
+    // minus = (v(x) + v(-x)) / 2, plus = (v(x) - v(-x)) / 2
+    static void toom_interpolate_pm(limb_t * plus, int * plus_size, limb_t * minus, int * minus_size, bool minus_negative)
     {
-        limb_t lhs_digit = lhs[lhs_size - 1];
-        limb_double_t num;
+        if (minus_negative)
+            *minus_size = sub(minus, plus, minus, *plus_size, *minus_size);
+        else
+            *minus_size = add(minus, plus, minus, *plus_size, *minus_size);
+        *minus_size = shift_right(minus, minus, *minus_size, 1);
+        *plus_size = sub(plus, plus, minus, *plus_size, *minus_size);
+    }
 
-        quotient[lhs_size - 1] = lhs_digit / rhs;
-        lhs_digit = lhs_digit % rhs;
-        for (int i = lhs_size - 2; i >= 0; --i)
+    // result holds size limbs with the coefficient at offset zeroed or partially summed, coefficient << offset must fit
+    static void toom_add_coefficient(limb_t * result, int size, limb_t const * coefficient, int coefficient_size, int offset)
+    {
+        assert(coefficient_size <= size - offset);
+        add(result + offset, result + offset, coefficient, size - offset, coefficient_size);
+    }
+
+    // a(1), |a(-1)| and a(2) of a0 + a1 * x + a2 * x^2, returns true if a(-1) is negative
+    static bool toom3_evaluate(limb_t * p1, int * p1_size, limb_t * pm1, int * pm1_size, limb_t * p2, int * p2_size, limb_t const * a0, limb_t const * a1, limb_t const * a2, int a0_size, int a1_size, int a2_size)
+    {
+        *p1_size = add(p1, a0, a2, a0_size, a2_size);
+        bool const negative = toom_evaluate_pm(p1, p1_size, pm1, pm1_size, p1, *p1_size, a1, a1_size);
+
+        // a(2) = 2 * (a(1) + a2) - a0
+        *p2_size = add(p2, p1, a2, *p1_size, a2_size);
+        *p2_size = add(p2, p2, p2, *p2_size, *p2_size);
+        *p2_size = sub(p2, p2, a0, *p2_size, a0_size);
+        return negative;
+    }
+
+    // evaluation points 0, 1, -1, 2 and infinity
+    static int toom3(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * memory)
+    {
+        int const k = (std::max(lhs_size, rhs_size) + 2) / 3;
+        int const size = lhs_size + rhs_size;
+
+        limb_t const * const a0 = lhs;
+        limb_t const * const a1 = lhs + k;
+        limb_t const * const a2 = lhs + k * 2;
+        limb_t const * const b0 = rhs;
+        limb_t const * const b1 = rhs + k;
+        limb_t const * const b2 = rhs + k * 2;
+        int const a0_size = trimmed_size(a0, k);
+        int const a1_size = trimmed_size(a1, k);
+        int const a2_size = trimmed_size(a2, lhs_size - k * 2);
+        int const b0_size = trimmed_size(b0, k);
+        int const b1_size = trimmed_size(b1, k);
+        int const b2_size = trimmed_size(b2, rhs_size - k * 2);
+
+        limb_t * const v1 = memory;
+        limb_t * const vm1 = v1 + (k + 1) * 2;
+        limb_t * const v2 = vm1 + (k + 1) * 2;
+        limb_t * const p1 = v2 + (k + 1) * 2;
+        limb_t * const pm1 = p1 + k + 1;
+        limb_t * const p2 = pm1 + k + 1;
+
+        // squaring evaluates lhs only, mul_with_scratch_memory then routes the products to sqr_with_scratch_memory
+        bool const square = lhs == rhs && lhs_size == rhs_size;
+        limb_t * const q1 = square ? p1 : p2 + k + 1;
+        limb_t * const qm1 = square ? pm1 : p2 + (k + 1) * 2;
+        limb_t * const q2 = square ? p2 : p2 + (k + 1) * 3;
+        memory = p2 + (k + 1) * 4;
+
+        int p1_size;
+        int pm1_size;
+        int p2_size;
+        bool const pm1_negative = toom3_evaluate(p1, &p1_size, pm1, &pm1_size, p2, &p2_size, a0, a1, a2, a0_size, a1_size, a2_size);
+        int q1_size = p1_size;
+        int qm1_size = pm1_size;
+        int q2_size = p2_size;
+        bool qm1_negative = pm1_negative;
+        if (!square)
+            qm1_negative = toom3_evaluate(q1, &q1_size, qm1, &qm1_size, q2, &q2_size, b0, b1, b2, b0_size, b1_size, b2_size);
+
+        limb_t * const c0 = result;
+        limb_t * const c4 = result + k * 4;
+        sub_product products[] =
         {
-            num = static_cast<limb_double_t>(lhs_digit) << (sizeof(limb_t) * 8);
-            num |= lhs[i];
-            quotient[i] = static_cast<limb_t>(num / rhs);
-            lhs_digit = num % rhs;
-            if (lhs_digit >= rhs)
+            { v1, p1, q1, p1_size, q1_size, 0 },
+            { vm1, pm1, qm1, pm1_size, qm1_size, 0 },
+            { v2, p2, q2, p2_size, q2_size, 0 },
+            { c0, a0, b0, a0_size, b0_size, 0 },
+            { c4, a2, b2, a2_size, b2_size, 0 },
+        };
+        multiply_all(products, 5, memory);
+        int v1_size = products[0].result_size;
+        int vm1_size = products[1].result_size;
+        int v2_size = products[2].result_size;
+        int const c0_size = products[3].result_size;
+        int const c4_size = products[4].result_size;
+        bool const vm1_negative = pm1_negative != qm1_negative;
+
+        for (int i = c0_size; i < k * 4; ++i)
+            result[i] = 0;
+        for (int i = k * 4 + c4_size; i < size; ++i)
+            result[i] = 0;
+
+        // vm1 = c0 + c2 + c4, v1 = c1 + c3
+        toom_interpolate_pm(v1, &v1_size, vm1, &vm1_size, vm1_negative);
+        vm1_size = sub(vm1, vm1, c0, vm1_size, c0_size);
+        vm1_size = sub(vm1, vm1, c4, vm1_size, c4_size);
+
+        // v2 = (v(2) - c0 - 4 * c2 - 16 * c4) / 2 - (c1 + c3) = 3 * c3
+        v2_size = sub(v2, v2, c0, v2_size, c0_size);
+        v2_size = sub_mul_by_one_digit(v2, v2, vm1, v2_size, vm1_size, 4);
+        v2_size = sub_mul_by_one_digit(v2, v2, c4, v2_size, c4_size, 16);
+        v2_size = shift_right(v2, v2, v2_size, 1);
+        v2_size = sub(v2, v2, v1, v2_size, v1_size);
+        v2_size = divexact_by_one_digit(v2, v2, v2_size, 3);
+        v1_size = sub(v1, v1, v2, v1_size, v2_size);
+
+        toom_add_coefficient(result, size, v1, v1_size, k);
+        toom_add_coefficient(result, size, vm1, vm1_size, k * 2);
+        toom_add_coefficient(result, size, v2, v2_size, k * 3);
+        return trimmed_size(result, size);
+    }
+
+    // a(1), |a(-1)|, a(2), |a(-2)| and a(3) of a0 + a1 * x + a2 * x^2 + a3 * x^3, odd is scratch
+    static void toom4_evaluate(limb_t * p1, int * p1_size, limb_t * pm1, int * pm1_size, bool * pm1_negative, limb_t * p2, int * p2_size, limb_t * pm2, int * pm2_size, bool * pm2_negative, limb_t * p3, int * p3_size, limb_t * odd, limb_t const * a0, limb_t const * a1, limb_t const * a2, limb_t const * a3, int a0_size, int a1_size, int a2_size, int a3_size)
+    {
+        int odd_size;
+
+        // a(1) and a(-1) from a0 + a2 and a1 + a3
+        *p1_size = add(p1, a0, a2, a0_size, a2_size);
+        odd_size = add(odd, a1, a3, a1_size, a3_size);
+        *pm1_negative = toom_evaluate_pm(p1, p1_size, pm1, pm1_size, p1, *p1_size, odd, odd_size);
+
+        // a(2) and a(-2) from a0 + 4 * a2 and 2 * (a1 + 4 * a3)
+        *p2_size = mul_by_one_digit(p2, a2, a2_size, 4);
+        *p2_size = add(p2, p2, a0, *p2_size, a0_size);
+        odd_size = mul_by_one_digit(odd, a3, a3_size, 4);
+        odd_size = add(odd, odd, a1, odd_size, a1_size);
+        odd_size = add(odd, odd, odd, odd_size, odd_size);
+        *pm2_negative = toom_evaluate_pm(p2, p2_size, pm2, pm2_size, p2, *p2_size, odd, odd_size);
+
+        // a(3) = ((3 * a3 + a2) * 3 + a1) * 3 + a0
+        *p3_size = mul_by_one_digit(p3, a3, a3_size, 3);
+        *p3_size = add(p3, p3, a2, *p3_size, a2_size);
+        *p3_size = mul_by_one_digit(p3, p3, *p3_size, 3);
+        *p3_size = add(p3, p3, a1, *p3_size, a1_size);
+        *p3_size = mul_by_one_digit(p3, p3, *p3_size, 3);
+        *p3_size = add(p3, p3, a0, *p3_size, a0_size);
+    }
+
+    // evaluation points 0, 1, -1, 2, -2, 3 and infinity
+    static int toom4(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * memory)
+    {
+        int const k = (std::max(lhs_size, rhs_size) + 3) / 4;
+        int const size = lhs_size + rhs_size;
+
+        limb_t const * const a0 = lhs;
+        limb_t const * const a1 = lhs + k;
+        limb_t const * const a2 = lhs + k * 2;
+        limb_t const * const a3 = lhs + k * 3;
+        limb_t const * const b0 = rhs;
+        limb_t const * const b1 = rhs + k;
+        limb_t const * const b2 = rhs + k * 2;
+        limb_t const * const b3 = rhs + k * 3;
+        int const a0_size = trimmed_size(a0, k);
+        int const a1_size = trimmed_size(a1, k);
+        int const a2_size = trimmed_size(a2, k);
+        int const a3_size = trimmed_size(a3, lhs_size - k * 3);
+        int const b0_size = trimmed_size(b0, k);
+        int const b1_size = trimmed_size(b1, k);
+        int const b2_size = trimmed_size(b2, k);
+        int const b3_size = trimmed_size(b3, rhs_size - k * 3);
+
+        limb_t * const v1 = memory;
+        limb_t * const vm1 = v1 + (k + 1) * 2;
+        limb_t * const v2 = vm1 + (k + 1) * 2;
+        limb_t * const vm2 = v2 + (k + 1) * 2;
+        limb_t * const v3 = vm2 + (k + 1) * 2;
+        limb_t * const odd = v3 + (k + 1) * 2;
+        limb_t * const p1 = odd + k + 1;
+        limb_t * const pm1 = p1 + k + 1;
+        limb_t * const p2 = pm1 + k + 1;
+        limb_t * const pm2 = p2 + k + 1;
+        limb_t * const p3 = pm2 + k + 1;
+
+        // squaring evaluates lhs only, mul_with_scratch_memory then routes the products to sqr_with_scratch_memory
+        bool const square = lhs == rhs && lhs_size == rhs_size;
+        limb_t * const q1 = square ? p1 : p3 + k + 1;
+        limb_t * const qm1 = square ? pm1 : p3 + (k + 1) * 2;
+        limb_t * const q2 = square ? p2 : p3 + (k + 1) * 3;
+        limb_t * const qm2 = square ? pm2 : p3 + (k + 1) * 4;
+        limb_t * const q3 = square ? p3 : p3 + (k + 1) * 5;
+        memory = p3 + (k + 1) * 6;
+
+        int p1_size;
+        int pm1_size;
+        int p2_size;
+        int pm2_size;
+        int p3_size;
+        bool pm1_negative;
+        bool pm2_negative;
+        toom4_evaluate(p1, &p1_size, pm1, &pm1_size, &pm1_negative, p2, &p2_size, pm2, &pm2_size, &pm2_negative, p3, &p3_size, odd, a0, a1, a2, a3, a0_size, a1_size, a2_size, a3_size);
+        int q1_size = p1_size;
+        int qm1_size = pm1_size;
+        int q2_size = p2_size;
+        int qm2_size = pm2_size;
+        int q3_size = p3_size;
+        bool qm1_negative = pm1_negative;
+        bool qm2_negative = pm2_negative;
+        if (!square)
+            toom4_evaluate(q1, &q1_size, qm1, &qm1_size, &qm1_negative, q2, &q2_size, qm2, &qm2_size, &qm2_negative, q3, &q3_size, odd, b0, b1, b2, b3, b0_size, b1_size, b2_size, b3_size);
+
+        limb_t * const c0 = result;
+        limb_t * const c6 = result + k * 6;
+        sub_product products[] =
+        {
+            { v1, p1, q1, p1_size, q1_size, 0 },
+            { vm1, pm1, qm1, pm1_size, qm1_size, 0 },
+            { v2, p2, q2, p2_size, q2_size, 0 },
+            { vm2, pm2, qm2, pm2_size, qm2_size, 0 },
+            { v3, p3, q3, p3_size, q3_size, 0 },
+            { c0, a0, b0, a0_size, b0_size, 0 },
+            { c6, a3, b3, a3_size, b3_size, 0 },
+        };
+        multiply_all(products, 7, memory);
+        int v1_size = products[0].result_size;
+        int vm1_size = products[1].result_size;
+        int v2_size = products[2].result_size;
+        int vm2_size = products[3].result_size;
+        int v3_size = products[4].result_size;
+        int const c0_size = products[5].result_size;
+        int const c6_size = products[6].result_size;
+        bool const vm1_negative = pm1_negative != qm1_negative;
+        bool const vm2_negative = pm2_negative != qm2_negative;
+
+        for (int i = c0_size; i < k * 6; ++i)
+            result[i] = 0;
+        for (int i = k * 6 + c6_size; i < size; ++i)
+            result[i] = 0;
+
+        // vm1 = c0 + c2 + c4 + c6, v1 = c1 + c3 + c5
+        // vm2 = c0 + 4 * c2 + 16 * c4 + 64 * c6, v2 = (c1 + 4 * c3 + 16 * c5) * 2
+        toom_interpolate_pm(v1, &v1_size, vm1, &vm1_size, vm1_negative);
+        toom_interpolate_pm(v2, &v2_size, vm2, &vm2_size, vm2_negative);
+        v2_size = shift_right(v2, v2, v2_size, 1);
+
+        // vm1 = c2 + c4, vm2 = c2 + 4 * c4, then vm2 = c4 and vm1 = c2
+        vm1_size = sub(vm1, vm1, c0, vm1_size, c0_size);
+        vm1_size = sub(vm1, vm1, c6, vm1_size, c6_size);
+        vm2_size = sub(vm2, vm2, c0, vm2_size, c0_size);
+        vm2_size = sub_mul_by_one_digit(vm2, vm2, c6, vm2_size, c6_size, 64);
+        vm2_size = shift_right(vm2, vm2, vm2_size, 2);
+        vm2_size = sub(vm2, vm2, vm1, vm2_size, vm1_size);
+        vm2_size = divexact_by_one_digit(vm2, vm2, vm2_size, 3);
+        vm1_size = sub(vm1, vm1, vm2, vm1_size, vm2_size);
+
+        // v3 = c1 + 9 * c3 + 81 * c5
+        v3_size = sub(v3, v3, c0, v3_size, c0_size);
+        v3_size = sub_mul_by_one_digit(v3, v3, vm1, v3_size, vm1_size, 9);
+        v3_size = sub_mul_by_one_digit(v3, v3, vm2, v3_size, vm2_size, 81);
+        v3_size = sub_mul_by_one_digit(v3, v3, c6, v3_size, c6_size, 729);
+        v3_size = divexact_by_one_digit(v3, v3, v3_size, 3);
+
+        // v2 = c3 + 5 * c5, v3 = c3 + 10 * c5, then v3 = c5, v2 = c3 and v1 = c1
+        v2_size = sub(v2, v2, v1, v2_size, v1_size);
+        v2_size = divexact_by_one_digit(v2, v2, v2_size, 3);
+        v3_size = sub(v3, v3, v1, v3_size, v1_size);
+        v3_size = shift_right(v3, v3, v3_size, 3);
+        v3_size = sub(v3, v3, v2, v3_size, v2_size);
+        v3_size = divexact_by_one_digit(v3, v3, v3_size, 5);
+        v2_size = sub_mul_by_one_digit(v2, v2, v3, v2_size, v3_size, 5);
+        v1_size = sub(v1, v1, v2, v1_size, v2_size);
+        v1_size = sub(v1, v1, v3, v1_size, v3_size);
+
+        toom_add_coefficient(result, size, v1, v1_size, k);
+        toom_add_coefficient(result, size, vm1, vm1_size, k * 2);
+        toom_add_coefficient(result, size, v2, v2_size, k * 3);
+        toom_add_coefficient(result, size, vm2, vm2_size, k * 4);
+        toom_add_coefficient(result, size, v3, v3_size, k * 5);
+        return trimmed_size(result, size);
+    }
+
+    // number theoretic transform over three primes below 2^31 with 32-bit coefficients, the coefficients of the
+    // product are below min(lhs, rhs) * 2^64 which stays below the product of the primes (~2^86.7) as long as the
+    // product has at most 2^23 coefficients
+    static constexpr int NTT_MAX_LENGTH = 1 << 23;
+    static constexpr ::uint32_t NTT_PRIME1 = 2013265921; // 15 * 2^27 + 1
+    static constexpr ::uint32_t NTT_PRIME2 = 469762049; // 7 * 2^26 + 1
+    static constexpr ::uint32_t NTT_PRIME3 = 167772161; // 5 * 2^25 + 1
+    static constexpr int NTT_COEFFICIENTS_PER_LIMB = sizeof(limb_t) / sizeof(::uint32_t);
+
+    static constexpr ::uint32_t ntt_pow(::uint32_t base, ::uint32_t exponent, ::uint32_t modulus)
+    {
+        ::uint64_t result = 1;
+        ::uint64_t power = base;
+        while (exponent > 0)
+        {
+            if (exponent & 1)
+                result = result * power % modulus;
+            power = power * power % modulus;
+            exponent >>= 1;
+        }
+        return static_cast<::uint32_t>(result);
+    }
+
+    static void ntt_load(::uint32_t * coefficients, limb_t const * digits, int size, int length, ::uint32_t modulus)
+    {
+        int index = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            limb_t digit = digits[i];
+            for (int j = 0; j < NTT_COEFFICIENTS_PER_LIMB; ++j)
             {
-                quotient[i] = lhs_digit / rhs;
-                lhs_digit = lhs_digit % rhs;
+                coefficients[index++] = static_cast<::uint32_t>(digit) % modulus;
+                digit = static_cast<limb_t>(static_cast<limb_double_t>(digit) >> 32);
             }
         }
-        *remainder = lhs_digit;
-        if (lhs_size > 1 && quotient[lhs_size - 1] == 0)
-            return lhs_size - 1;
-        return lhs_size;
+        while (index < length)
+            coefficients[index++] = 0;
     }
 
-    static limb_t mod_by_one_digit(limb_t const * lhs, limb_t rhs, int lhs_size)
+    // decimation in frequency, natural order in and bit reversed order out
+    // roots[j] = w^j for j < length / 2 with w a primitive length-th root of unity
+    template <::uint32_t modulus>
+    static void ntt_forward(::uint32_t * a, int length, ::uint32_t const * roots)
     {
-        limb_t lhs_digit = lhs[lhs_size - 1];
-        limb_double_t num;
-
-        lhs_digit = lhs_digit % rhs;
-        for (int i = lhs_size - 2; i >= 0; --i)
+        for (int half = length / 2, stride = 1; half >= 1; half /= 2, stride *= 2)
         {
-            num = static_cast<limb_double_t>(lhs_digit) << (sizeof(limb_t) * 8);
-            num |= lhs[i];
-            lhs_digit = num % rhs;
-            if (lhs_digit >= rhs)
+            for (int start = 0; start < length; start += half * 2)
             {
-                lhs_digit = lhs_digit % rhs;
+                for (int j = 0; j < half; ++j)
+                {
+                    ::uint32_t const u = a[start + j];
+                    ::uint32_t const v = a[start + j + half];
+                    ::uint32_t const sum = u + v;
+                    a[start + j] = sum >= modulus ? sum - modulus : sum;
+                    a[start + j + half] = static_cast<::uint32_t>(static_cast<::uint64_t>(u + modulus - v) * roots[j * stride] % modulus);
+                }
             }
         }
-        return lhs_digit;
     }
 
-    static constexpr limb_t largest_base10_numerator_fitting_in_limb()
+    // decimation in time, bit reversed order in and natural order out, scaled by 1 / length
+    template <::uint32_t modulus>
+    static void ntt_inverse(::uint32_t * a, int length, ::uint32_t const * roots)
     {
-        constexpr limb_double_t limit = static_cast<limb_double_t>(1) << 32;
-        limb_double_t n = 1;
-        while (n < limit)
+        for (int half = 1, stride = length / 2; half < length; half *= 2, stride /= 2)
         {
-            n *= 10;
+            for (int start = 0; start < length; start += half * 2)
+            {
+                for (int j = 0; j < half; ++j)
+                {
+                    // w^-j = -w^(length / 2 - j)
+                    ::uint32_t const root = j == 0 ? 1 : modulus - roots[(length / 2) - j * stride];
+                    ::uint32_t const u = a[start + j];
+                    ::uint32_t const v = static_cast<::uint32_t>(static_cast<::uint64_t>(a[start + j + half]) * root % modulus);
+                    ::uint32_t const sum = u + v;
+                    a[start + j] = sum >= modulus ? sum - modulus : sum;
+                    a[start + j + half] = u >= v ? u - v : u + modulus - v;
+                }
+            }
         }
-        return static_cast<limb_t>(n / 10);
+        ::uint64_t const scale = ntt_pow(static_cast<::uint32_t>(length), modulus - 2, modulus);
+        for (int i = 0; i < length; ++i)
+            a[i] = static_cast<::uint32_t>(a[i] * scale % modulus);
     }
 
-    static constexpr int largest_base10_numerator_fitting_in_limb_size()
+    // residues receives the cyclic convolution of lhs and rhs modulo the prime, other and roots are scratch
+    // rhs is only transformed when it differs from lhs
+    template <::uint32_t modulus, ::uint32_t generator>
+    static void ntt_convolution(::uint32_t * residues, ::uint32_t * other, ::uint32_t * roots, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, int length)
     {
-        constexpr limb_double_t limit = static_cast<limb_double_t>(1) << 32;
-        limb_double_t n = 1;
-        int result = 0;
-        while (n < limit)
+        ::uint64_t const root = ntt_pow(generator, (modulus - 1) / length, modulus);
+        roots[0] = 1;
+        for (int i = 1; i < length / 2; ++i)
+            roots[i] = static_cast<::uint32_t>(roots[i - 1] * root % modulus);
+
+        ntt_load(residues, lhs, lhs_size, length, modulus);
+        ntt_forward<modulus>(residues, length, roots);
+        if (lhs == rhs && lhs_size == rhs_size)
         {
-            n *= 10;
-            result++;
+            for (int i = 0; i < length; ++i)
+                residues[i] = static_cast<::uint32_t>(static_cast<::uint64_t>(residues[i]) * residues[i] % modulus);
         }
-        return result - 1;
+        else
+        {
+            ntt_load(other, rhs, rhs_size, length, modulus);
+            ntt_forward<modulus>(other, length, roots);
+            for (int i = 0; i < length; ++i)
+                residues[i] = static_cast<::uint32_t>(static_cast<::uint64_t>(residues[i]) * other[i] % modulus);
+        }
+        ntt_inverse<modulus>(residues, length, roots);
     }
 
-    void set_allocator(void * (*alloc)(size_t), void (*dealloc)(void *))
+    struct ntt_job
     {
-        g_allocate = alloc == nullptr ? ::malloc : alloc;
-        g_deallocate = dealloc == nullptr ? ::free : dealloc;
+        ::uint32_t * residues;
+        limb_t const * lhs;
+        limb_t const * rhs;
+        int lhs_size;
+        int rhs_size;
+        int length;
+    };
+
+    template <::uint32_t modulus, ::uint32_t generator>
+    static void run_ntt_job(void * argument)
+    {
+        ntt_job const * const job = static_cast<ntt_job const *>(argument);
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        int const count = job->length + job->length / 2;
+        ::uint32_t * const other = reinterpret_cast<::uint32_t *>(workspace.allocate(count / NTT_COEFFICIENTS_PER_LIMB + 1));
+        ntt_convolution<modulus, generator>(job->residues, other, other + job->length, job->lhs, job->rhs, job->lhs_size, job->rhs_size, job->length);
+        workspace.release(mark);
     }
 
-    int from_base10(limb_t * digits, char const * str, int length)
+    static int ntt_length(int lhs_size, int rhs_size)
     {
-        int result_size = 1;
+        int const coefficients = (lhs_size + rhs_size) * NTT_COEFFICIENTS_PER_LIMB;
+        int length = 1;
+        while (length < coefficients)
+            length *= 2;
+        return length;
+    }
 
-        *digits = 0;
-        for (int i = 0; i < length; ++i)
+    // memory must hold 4.5 * ntt_length(lhs_size, rhs_size) 32-bit words
+    static int ntt_multiplication(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * memory)
+    {
+        constexpr ::uint64_t p1 = NTT_PRIME1;
+        constexpr ::uint64_t p2 = NTT_PRIME2;
+        constexpr ::uint64_t p3 = NTT_PRIME3;
+        constexpr ::uint64_t p1_inverse = ntt_pow(NTT_PRIME1 % NTT_PRIME2, NTT_PRIME2 - 2, NTT_PRIME2);
+        constexpr ::uint64_t p1p2_inverse = ntt_pow(static_cast<::uint32_t>((p1 % p3) * (p2 % p3) % p3), NTT_PRIME3 - 2, NTT_PRIME3);
+        constexpr ::uint64_t p1p2 = p1 * p2;
+        constexpr ::uint64_t p1p2_low = p1p2 & 0xffffffff;
+        constexpr ::uint64_t p1p2_high = p1p2 >> 32;
+
+        int const length = ntt_length(lhs_size, rhs_size);
+        ::uint32_t * const r1 = reinterpret_cast<::uint32_t *>(memory);
+        ::uint32_t * const r2 = r1 + length;
+        ::uint32_t * const r3 = r2 + length;
+        ::uint32_t * const other = r3 + length;
+        ::uint32_t * const roots = other + length;
+
+        if (parallel(std::min(lhs_size, rhs_size)))
+        {
+            // the convolutions modulo the second and third primes get their own other and roots buffers
+            ntt_job jobs[2] =
+            {
+                { r2, lhs, rhs, lhs_size, rhs_size, length },
+                { r3, lhs, rhs, lhs_size, rhs_size, length },
+            };
+            task tasks[2];
+            tasks[0].run = &run_ntt_job<NTT_PRIME2, 3>;
+            tasks[0].argument = &jobs[0];
+            tasks[1].run = &run_ntt_job<NTT_PRIME3, 3>;
+            tasks[1].argument = &jobs[1];
+            g_task_pool->fork(&tasks[0]);
+            g_task_pool->fork(&tasks[1]);
+            ntt_convolution<NTT_PRIME1, 31>(r1, other, roots, lhs, rhs, lhs_size, rhs_size, length);
+            g_task_pool->join(&tasks[1]);
+            g_task_pool->join(&tasks[0]);
+        }
+        else
         {
-            constexpr limb_double_t base = static_cast<limb_double_t>(1) << (sizeof(limb_t) * 8);
+            ntt_convolution<NTT_PRIME1, 31>(r1, other, roots, lhs, rhs, lhs_size, rhs_size, length);
+            ntt_convolution<NTT_PRIME2, 3>(r2, other, roots, lhs, rhs, lhs_size, rhs_size, length);
+            ntt_convolution<NTT_PRIME3, 3>(r3, other, roots, lhs, rhs, lhs_size, rhs_size, length);
+        }
 
-            limb_t carry = str[i] - '0';
-            if (carry >= 10)
-                return -1;
-            for (int j = 0; j < result_size; ++j)
+        // garner's algorithm, value = x1 + x2 * p1 + x3 * p1 * p2, propagated 32 bits at a time
+        int const size = lhs_size + rhs_size;
+        ::uint64_t carry = 0;
+        int index = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            limb_t digit = 0;
+            for (int j = 0; j < NTT_COEFFICIENTS_PER_LIMB; ++j, ++index)
             {
-                limb_double_t const product = carry + static_cast<limb_double_t>(digits[j]) * 10;
-                carry = static_cast<limb_t>(product / base);
-                digits[j] = product % base;
+                ::uint64_t const x1 = r1[index];
+                ::uint64_t const x2 = (r2[index] + p2 - x1 % p2) * p1_inverse % p2;
+                ::uint64_t const low = x1 + x2 * p1;
+                ::uint64_t const x3 = (r3[index] + p3 - low % p3) * p1p2_inverse % p3;
+                ::uint64_t const sum = low + carry + x3 * p1p2_low;
+                digit |= static_cast<limb_t>(sum & 0xffffffff) << (32 * j);
+                carry = (sum >> 32) + x3 * p1p2_high;
             }
-            if (carry > 0)
+            result[i] = digit;
+        }
+        assert(carry == 0);
+        return trimmed_size(result, size);
+    }
+
+    static int mul_with_scratch_memory(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * memory)
+    {
+        if ((lhs_size == 1 && *lhs == 0) || (rhs_size == 1 && *rhs == 0))
+        {
+            *result = 0;
+            return 1;
+        }
+        if (lhs_size == 1 && rhs_size == 1)
+        {
+            limb_double_t const product = static_cast<limb_double_t>(*lhs) * static_cast<limb_double_t>(*rhs);
+            result[0] = static_cast<limb_t>(product);
+            result[1] = static_cast<limb_t>(product >> (sizeof(limb_t) * 8));
+            return result[1] == 0 ? 1 : 2;
+        }
+        if (lhs == rhs && lhs_size == rhs_size)
+        {
+            return sqr_with_scratch_memory(result, lhs, lhs_size, memory);
+        }
+
+        int const min_size = std::min(lhs_size, rhs_size);
+        int const max_size = std::max(lhs_size, rhs_size);
+
+        if (min_size > NTT_THRESHOLD && (lhs_size + rhs_size) * NTT_COEFFICIENTS_PER_LIMB <= NTT_MAX_LENGTH)
+        {
+            return ntt_multiplication(result, lhs, rhs, lhs_size, rhs_size, memory);
+        }
+        // toom needs every operand to be split in as many non empty pieces as it has
+        if (min_size > TOOM4_THRESHOLD && min_size > ((max_size + 3) / 4) * 3)
+        {
+            return toom4(result, lhs, rhs, lhs_size, rhs_size, memory);
+        }
+        if (min_size > TOOM3_THRESHOLD && min_size > ((max_size + 2) / 3) * 2)
+        {
+            return toom3(result, lhs, rhs, lhs_size, rhs_size, memory);
+        }
+        if (min_size > KARATSUBA_THRESHOLD)
+        {
+            return karatsuba(result, lhs, rhs, lhs_size, rhs_size, memory);
+        }
+        return long_multiplication(result, lhs, rhs, lhs_size, rhs_size);
+    }
+
+    static int sqr_with_scratch_memory(limb_t * result, limb_t const * digits, int size, limb_t * memory)
+    {
+        if (size == 1)
+        {
+            limb_double_t const product = static_cast<limb_double_t>(*digits) * static_cast<limb_double_t>(*digits);
+            result[0] = static_cast<limb_t>(product);
+            result[1] = static_cast<limb_t>(product >> (sizeof(limb_t) * 8));
+            return result[1] == 0 ? 1 : 2;
+        }
+
+        if (size > NTT_THRESHOLD && size * 2 * NTT_COEFFICIENTS_PER_LIMB <= NTT_MAX_LENGTH)
+        {
+            return ntt_multiplication(result, digits, digits, size, size, memory);
+        }
+        if (size > TOOM4_THRESHOLD)
+        {
+            return toom4(result, digits, digits, size, size, memory);
+        }
+        if (size > TOOM3_THRESHOLD)
+        {
+            return toom3(result, digits, digits, size, size, memory);
+        }
+        if (size > KARATSUBA_SQUARING_THRESHOLD)
+        {
+            return karatsuba_squaring(result, digits, size, memory);
+        }
+        return long_squaring(result, digits, size);
+    }
+
+    // adds size limbs of other to digits, returns the carry out of the last limb
+    static limb_t add_in_place(limb_t * digits, limb_t const * other, int size)
+    {
+        limb_t carry = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            limb_t digit = digits[i] + carry;
+            carry = (digit < carry) ? 1 : 0;
+            digit += other[i];
+            carry = (digit < other[i]) ? 1 : carry;
+            digits[i] = digit;
+        }
+        return carry;
+    }
+
+    // subtracts size limbs of other from digits, returns the borrow out of the last limb
+    static limb_t sub_in_place(limb_t * digits, limb_t const * other, int size)
+    {
+        limb_t borrow = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            limb_t const digit = digits[i];
+            limb_t const difference = digit - other[i] - borrow;
+            borrow = (digit < other[i] || (borrow == 1 && digit == other[i])) ? 1 : 0;
+            digits[i] = difference;
+        }
+        return borrow;
+    }
+
+    // subtracts one from size limbs, returns the borrow out of the last limb
+    static limb_t decrement(limb_t * digits, int size)
+    {
+        for (int i = 0; i < size; ++i)
+        {
+            if (digits[i]-- != 0)
+                return 0;
+        }
+        return 1;
+    }
+
+    // adds one to size limbs, returns the carry out of the last limb
+    static limb_t increment(limb_t * digits, int size)
+    {
+        for (int i = 0; i < size; ++i)
+        {
+            if (++digits[i] != 0)
+                return 0;
+        }
+        return 1;
+    }
+
+    // bits counted in parallel within each byte, then summed by the multiplication
+    static int limb_popcount(limb_t digit)
+    {
+        ::uint64_t x = digit;
+        x = x - ((x >> 1) & 0x5555555555555555);
+        x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+        x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
+        return static_cast<int>((x * 0x0101010101010101) >> 56);
+    }
+
+    // https://skanthak.hier-im-netz.de/division.html
+    // divides lhs in place by rhs, whose most significant bit must be set and which needs at least two limbs, the
+    // lhs_size - rhs_size low limbs of the quotient go to quotient and the remainder to the rhs_size low limbs of lhs
+    // returns the quotient limb above them, which is one when the rhs_size high limbs of lhs are not below rhs
+    template <bool ignore_quotient>
+    static limb_t divide_normalized(limb_t * quotient, limb_t * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        constexpr limb_double_t base = static_cast<limb_double_t>(1) << (sizeof(limb_t) * 8);
+        assert(rhs_size >= 2 && (rhs[rhs_size - 1] >> (limb_bits - 1)) == 1);
+
+        limb_t high = 0;
+        if (compare(lhs + lhs_size - rhs_size, rhs, rhs_size, rhs_size) >= 0)
+        {
+            sub_in_place(lhs + lhs_size - rhs_size, rhs, rhs_size);
+            high = 1;
+        }
+
+        for (int j = lhs_size - rhs_size - 1; j >= 0; j--) {
+            // Compute estimate quotient_digit of quotient[j].
+            limb_double_t quotient_digit = (lhs[j + rhs_size] * base + lhs[j + rhs_size - 1]) / rhs[rhs_size - 1];
+            limb_double_t remainder_digit = (lhs[j + rhs_size] * base + lhs[j + rhs_size - 1]) % rhs[rhs_size - 1];
+
+            while (quotient_digit >= base || static_cast<limb_t>(quotient_digit) * static_cast<limb_double_t>(rhs[rhs_size - 2]) > base * remainder_digit + lhs[j + rhs_size - 2])
             {
-                digits[result_size] = carry;
-                result_size++;
+                quotient_digit = quotient_digit - 1;
+                remainder_digit = remainder_digit + rhs[rhs_size - 1];
+                if (remainder_digit >= base)
+                {
+                    break;
+                }
+            }
+
+            // Multiply and subtract.
+            limb_signed_double_t diff = 0;
+            limb_signed_double_t sum;
+            for (int i = 0; i < rhs_size; i++) {
+                limb_double_t const product = static_cast<limb_t>(quotient_digit) * static_cast<limb_double_t>(rhs[i]);
+                sum = lhs[i + j] - diff - (product & (base - 1));
+                lhs[i + j] = static_cast<limb_t>(sum);
+                diff = (product >> limb_bits) - (sum >> limb_bits);
+            }
+            sum = lhs[j + rhs_size] - diff;
+            lhs[j + rhs_size] = static_cast<limb_t>(sum);
+
+            if (!ignore_quotient)
+                quotient[j] = static_cast<limb_t>(quotient_digit);
+
+            // If we subtracted too much, add back
+            if (sum < 0) {
+                if (!ignore_quotient)
+                    quotient[j] = quotient[j] - 1;
+                diff = 0;
+                for (int i = 0; i < rhs_size; i++) {
+                    sum = static_cast<limb_double_t>(lhs[i + j]) + rhs[i] + diff;
+                    lhs[i + j] = static_cast<limb_t>(sum);
+                    diff = sum >> limb_bits;
+                }
+                lhs[j + rhs_size] += static_cast<limb_t>(diff);
             }
         }
-        return result_size;
+        return high;
     }
 
-    int from_base16(limb_t * digits, char const * str, int length)
+    // shifts rhs left until its most significant bit is set and lhs by the same amount into lhs_size + 1 limbs,
+    // returns the shift
+    static int normalize(limb_t * lhs_normalized, limb_t * rhs_normalized, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
     {
-        int index = -1;
-        limb_t bitshift = 0;
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        int const shift = static_cast<int>(limb_bits - de_bruijn(rhs[rhs_size - 1]) - 1);
 
-        while (length > 1 && *str == '0')
-        {
-            length--;
-            str++;
+        shift_left(rhs_normalized, rhs, rhs_size, shift);
+        lhs_normalized[lhs_size] = shift_left(lhs_normalized, lhs, lhs_size, shift);
+        return shift;
+    }
+
+    template <bool ignore_quotient, bool ignore_remainder>
+    static int algorithm_d(limb_t * quotient, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * remainder, int * remainder_size, scratch & workspace)
+    {
+        /* Normalize by shifting rhs left just enough so that its high-order
+        bit is on, and shift lhs left the same amount. We may have to append a
+        high-order digit on the dividend; we do that unconditionally. */
+
+        size_t const mark = workspace.mark();
+        limb_t * const rhs_normalized = workspace.allocate(rhs_size);
+        limb_t * const lhs_normalized = workspace.allocate(lhs_size + 1);
+        int const shift = normalize(lhs_normalized, rhs_normalized, lhs, rhs, lhs_size, rhs_size);
+
+        // the appended digit keeps the rhs_size high limbs below rhs, so there is no quotient limb above
+        limb_t const high = divide_normalized<ignore_quotient>(quotient, lhs_normalized, rhs_normalized, lhs_size + 1, rhs_size);
+        assert(high == 0);
+        (void)high;
+
+        // If the caller wants the remainder, unnormalize it and pass it back.
+        if (!ignore_remainder)
+            *remainder_size = shift_right(remainder, lhs_normalized, rhs_size, shift);
+        workspace.release(mark);
+        if (!ignore_quotient)
+        {
+            int quotient_size = lhs_size - rhs_size + 1;
+            if (quotient[quotient_size - 1] == 0 && quotient_size > 1)
+                quotient_size--;
+            return quotient_size;
+        }
+        return 0;
+    }
+
+    // result = lhs * rhs over exactly lhs_size + rhs_size limbs, the operands do not need to be trimmed
+    static void mul_padded(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * memory)
+    {
+        int const size = mul_with_scratch_memory(result, lhs, rhs, trimmed_size(lhs, lhs_size), trimmed_size(rhs, rhs_size), memory);
+        for (int i = size; i < lhs_size + rhs_size; ++i)
+            result[i] = 0;
+    }
+
+    static limb_t burnikel_ziegler_block(limb_t * quotient, limb_t * lhs, limb_t const * rhs, int rhs_size, int quotient_size, limb_t * product, limb_t * memory);
+
+    // divides the size * 2 limbs of lhs in place by the size limbs of the normalized rhs, following divide_normalized,
+    // product holds size limbs, memory is the scratch memory of a size by size multiplication
+    static limb_t burnikel_ziegler_2n_by_n(limb_t * quotient, limb_t * lhs, limb_t const * rhs, int size, limb_t * product, limb_t * memory)
+    {
+        if (size < BURNIKEL_ZIEGLER_THRESHOLD)
+            return divide_normalized<false>(quotient, lhs, rhs, size * 2, size);
+
+        // high half of the quotient from the size * 3 / 2 high limbs of lhs, then the low half from what remains
+        int const low = size / 2;
+        int const high = size - low;
+        limb_t const quotient_high = burnikel_ziegler_block(quotient + low, lhs + low, rhs, size, high, product, memory);
+        limb_t const quotient_low = burnikel_ziegler_block(quotient, lhs, rhs, size, low, product, memory);
+        assert(quotient_low == 0);
+        (void)quotient_low;
+        return quotient_high;
+    }
+
+    // divides the rhs_size + quotient_size limbs of lhs in place by the rhs_size limbs of the normalized rhs, quotient_size
+    // being at most rhs_size: the quotient is estimated from the high limbs of rhs, then corrected with the low ones
+    static limb_t burnikel_ziegler_block(limb_t * quotient, limb_t * lhs, limb_t const * rhs, int rhs_size, int quotient_size, limb_t * product, limb_t * memory)
+    {
+        if (quotient_size == rhs_size)
+            return burnikel_ziegler_2n_by_n(quotient, lhs, rhs, rhs_size, product, memory);
+        if (quotient_size < BURNIKEL_ZIEGLER_THRESHOLD)
+            return divide_normalized<false>(quotient, lhs, rhs, rhs_size + quotient_size, rhs_size);
+
+        int const low_size = rhs_size - quotient_size;
+        limb_t high = burnikel_ziegler_2n_by_n(quotient, lhs + low_size, rhs + low_size, quotient_size, product, memory);
+
+        mul_padded(product, quotient, rhs, quotient_size, low_size, memory);
+        limb_t borrow = sub_in_place(lhs, product, rhs_size);
+        if (high != 0)
+            borrow += sub_in_place(lhs + quotient_size, rhs, low_size);
+        while (borrow != 0)
+        {
+            high -= decrement(quotient, quotient_size);
+            borrow -= add_in_place(lhs, rhs, rhs_size);
+        }
+        return high;
+    }
+
+    static int divide_by_one_digit(limb_t * quotient, limb_t const * lhs, limb_t rhs, int lhs_size, limb_t * remainder);
+
+    // result = base^(size * 2) / digits over size + 1 limbs, within a few units, digits most significant bit must be set
+    // newton iteration from the reciprocal of the high half: x = x + x * (base^(size * 2) - digits * x) / base^(size * 2)
+    static void reciprocal(limb_t * result, limb_t const * digits, int size, scratch & workspace)
+    {
+        size_t const mark = workspace.mark();
+        if (size < NEWTON_RECIPROCAL_THRESHOLD)
+        {
+            limb_t * const numerator = workspace.allocate(size * 2 + 1 + 3);
+            for (int i = 0; i < size * 2; ++i)
+                numerator[i] = 0;
+            numerator[size * 2] = 1;
+            if (size == 1)
+            {
+                limb_t * const quotient = numerator + 3;
+                limb_t remainder;
+                divide_by_one_digit(quotient, numerator, *digits, 3, &remainder);
+                result[0] = quotient[0];
+                result[1] = quotient[1];
+            }
+            else
+            {
+                divide_normalized<false>(result, numerator, digits, size * 2 + 1, size);
+            }
+            workspace.release(mark);
+            return;
+        }
+
+        // the high half holds enough limbs for one step to leave only a few units of error
+        static_assert(NEWTON_RECIPROCAL_THRESHOLD >= 4, "the high half must be smaller than size");
+        int const high = (size + 1) / 2 + 1;
+        int const low = size - high;
+        int const memory_size = high + 1 + (size + high + 1) + (size + high + 3) + mul_scratch_size(size + 2, size + 2);
+        limb_t * const high_reciprocal = workspace.allocate(memory_size);
+        limb_t * const error = high_reciprocal + high + 1;
+        limb_t * const correction = error + size + high + 1;
+        limb_t * const memory = correction + size + high + 3;
+        reciprocal(high_reciprocal, digits + low, high, workspace);
+
+        // error = |base^(size + high) - digits * high_reciprocal|, which fits in size + 2 limbs
+        mul_padded(error, digits, high_reciprocal, size, high + 1, memory);
+        bool const above = error[size + high] != 0;
+        if (above)
+        {
+            error[size + high] -= 1;
+        }
+        else
+        {
+            for (int i = 0; i < size + high; ++i)
+                error[i] = ~error[i];
+            increment(error, size + high);
+        }
+        assert(trimmed_size(error, size + high + 1) <= size + 2);
+
+        // result = high_reciprocal * base^low -+ high_reciprocal * error / base^(high * 2)
+        mul_padded(correction, high_reciprocal, error, high + 1, size + 2, memory);
+        for (int i = 0; i < low; ++i)
+            result[i] = 0;
+        for (int i = 0; i <= high; ++i)
+            result[low + i] = high_reciprocal[i];
+        if (above)
+        {
+            limb_t const borrow = sub_in_place(result, correction + high * 2, low + 3) != 0 ? decrement(result + low + 3, high - 2) : 0;
+            assert(borrow == 0);
+            (void)borrow;
+        }
+        else
+        {
+            limb_t const carry = add_in_place(result, correction + high * 2, low + 3) != 0 ? increment(result + low + 3, high - 2) : 0;
+            assert(carry == 0);
+            (void)carry;
+        }
+        workspace.release(mark);
+    }
+
+    // divides the rhs_size + quotient_size limbs of lhs in place by the rhs_size limbs of the normalized rhs, quotient_size
+    // being at most rhs_size and the rhs_size high limbs of lhs below rhs: the quotient estimated from the high limbs of lhs
+    // times the reciprocal is within a few units of the actual one, product holds rhs_size * 2 + 1 limbs
+    static void barrett_block(limb_t * quotient, limb_t * lhs, limb_t const * rhs, limb_t const * rhs_reciprocal, int rhs_size, int quotient_size, limb_t * product, limb_t * memory)
+    {
+        mul_padded(product, lhs + rhs_size, rhs_reciprocal, quotient_size, rhs_size + 1, memory);
+        for (int i = 0; i < quotient_size; ++i)
+            quotient[i] = product[rhs_size + i];
+        if (product[rhs_size + quotient_size] != 0)
+        {
+            // the estimate went past the largest possible quotient
+            for (int i = 0; i < quotient_size; ++i)
+                quotient[i] = ~static_cast<limb_t>(0);
+        }
+
+        mul_padded(product, quotient, rhs, quotient_size, rhs_size, memory);
+        limb_t borrow = sub_in_place(lhs, product, rhs_size + quotient_size);
+        while (borrow != 0)
+        {
+            decrement(quotient, quotient_size);
+            if (add_in_place(lhs, rhs, rhs_size) != 0)
+                borrow -= increment(lhs + rhs_size, quotient_size);
+        }
+        while (trimmed_size(lhs + rhs_size, quotient_size) > 1 || lhs[rhs_size] != 0 || compare(lhs, rhs, rhs_size, rhs_size) >= 0)
+        {
+            if (sub_in_place(lhs, rhs, rhs_size) != 0)
+                decrement(lhs + rhs_size, quotient_size);
+            increment(quotient, quotient_size);
+        }
+    }
+
+    // divides the quotient_size + rhs_size limbs of the normalized lhs in place, whose rhs_size high limbs are below rhs,
+    // rhs_size quotient limbs at a time from the top, the first block taking what is left over, as with the appended
+    // digit every block starts with a partial remainder below rhs, blocks are multiplied by rhs_reciprocal unless it is
+    // nullptr, product holds rhs_size * 2 + 1 limbs and memory is the scratch memory of a rhs_size + 1 multiplication
+    static void divide_blocks(limb_t * quotient, limb_t * lhs_normalized, limb_t const * rhs_normalized, limb_t const * rhs_reciprocal, int quotient_size, int rhs_size, limb_t * product, limb_t * memory)
+    {
+        int offset = quotient_size;
+        int block = quotient_size % rhs_size == 0 ? rhs_size : quotient_size % rhs_size;
+        while (offset > 0)
+        {
+            offset -= block;
+            if (rhs_reciprocal != nullptr)
+            {
+                barrett_block(quotient + offset, lhs_normalized + offset, rhs_normalized, rhs_reciprocal, rhs_size, block, product, memory);
+            }
+            else
+            {
+                limb_t const high = burnikel_ziegler_block(quotient + offset, lhs_normalized + offset, rhs_normalized, rhs_size, block, product, memory);
+                assert(high == 0);
+                (void)high;
+            }
+            block = rhs_size;
+        }
+    }
+
+    // same contract as algorithm_d, for a rhs and a quotient of at least BURNIKEL_ZIEGLER_THRESHOLD limbs, each block is
+    // either divided recursively or, with newton, multiplied by the reciprocal of rhs
+    template <bool ignore_quotient, bool ignore_remainder>
+    static int divide_by_blocks(limb_t * quotient, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * remainder, int * remainder_size, bool newton, scratch & workspace)
+    {
+        int const quotient_size = lhs_size - rhs_size + 1;
+        int const reciprocal_size = newton ? rhs_size + 1 : 0;
+        int const memory_size = lhs_size + 1 + rhs_size * 3 + 1 + reciprocal_size + (ignore_quotient ? quotient_size : 0) + mul_scratch_size(rhs_size + 1, rhs_size + 1);
+        size_t const mark = workspace.mark();
+        limb_t * const lhs_normalized = workspace.allocate(memory_size);
+        limb_t * const rhs_normalized = lhs_normalized + lhs_size + 1;
+        limb_t * const product = rhs_normalized + rhs_size;
+        limb_t * const rhs_reciprocal = product + rhs_size * 2 + 1;
+        limb_t * const q = ignore_quotient ? rhs_reciprocal + reciprocal_size : quotient;
+        limb_t * const memory = rhs_reciprocal + reciprocal_size + (ignore_quotient ? quotient_size : 0);
+        int const shift = normalize(lhs_normalized, rhs_normalized, lhs, rhs, lhs_size, rhs_size);
+        if (newton)
+            reciprocal(rhs_reciprocal, rhs_normalized, rhs_size, workspace);
+
+        divide_blocks(q, lhs_normalized, rhs_normalized, newton ? rhs_reciprocal : nullptr, quotient_size, rhs_size, product, memory);
+
+        if (!ignore_remainder)
+            *remainder_size = shift_right(remainder, lhs_normalized, rhs_size, shift);
+        int const size = ignore_quotient ? 0 : trimmed_size(quotient, quotient_size);
+        workspace.release(mark);
+        return size;
+    }
+
+    // https://gmplib.org/~tege/division-paper.pdf
+    // divides high * base + low by the normalized divisor from its reciprocal floor((base^2 - 1) / divisor) - base,
+    // high must be below divisor
+    static limb_t divide_by_reciprocal(limb_t * remainder, limb_t high, limb_t low, limb_t divisor, limb_t reciprocal)
+    {
+        constexpr int bits = sizeof(limb_t) * 8;
+        limb_double_t const estimate = static_cast<limb_double_t>(reciprocal) * high + ((static_cast<limb_double_t>(high) << bits) | low);
+        limb_t quotient = static_cast<limb_t>(estimate >> bits) + 1;
+        limb_t r = low - quotient * divisor;
+
+        // taken about half of the time, so without a branch
+        limb_t const mask = 0 - static_cast<limb_t>(r > static_cast<limb_t>(estimate));
+        quotient += mask;
+        r += mask & divisor;
+        if (r >= divisor)
+        {
+            quotient++;
+            r -= divisor;
+        }
+        *remainder = r;
+        return quotient;
+    }
+
+    static int divide_by_one_digit(limb_t * quotient, limb_t const * lhs, limb_t rhs, int lhs_size, limb_t * remainder)
+    {
+        if (lhs_size >= LIMB_DIVISOR_THRESHOLD)
+            return limb_divisor(rhs).divide(quotient, lhs, lhs_size, remainder);
+
+        limb_t lhs_digit = lhs[lhs_size - 1];
+        limb_double_t num;
+
+        quotient[lhs_size - 1] = lhs_digit / rhs;
+        lhs_digit = lhs_digit % rhs;
+        for (int i = lhs_size - 2; i >= 0; --i)
+        {
+            num = static_cast<limb_double_t>(lhs_digit) << (sizeof(limb_t) * 8);
+            num |= lhs[i];
+            quotient[i] = static_cast<limb_t>(num / rhs);
+            lhs_digit = num % rhs;
+            if (lhs_digit >= rhs)
+            {
+                quotient[i] = lhs_digit / rhs;
+                lhs_digit = lhs_digit % rhs;
+            }
+        }
+        *remainder = lhs_digit;
+        if (lhs_size > 1 && quotient[lhs_size - 1] == 0)
+            return lhs_size - 1;
+        return lhs_size;
+    }
+
+    static limb_t mod_by_one_digit(limb_t const * lhs, limb_t rhs, int lhs_size)
+    {
+        // computing the reciprocal takes a division, the shortest lhs use the hardware one
+        if (lhs_size >= LIMB_DIVISOR_THRESHOLD)
+            return limb_divisor(rhs).mod(lhs, lhs_size);
+
+        limb_t lhs_digit = lhs[lhs_size - 1];
+        limb_double_t num;
+
+        lhs_digit = lhs_digit % rhs;
+        for (int i = lhs_size - 2; i >= 0; --i)
+        {
+            num = static_cast<limb_double_t>(lhs_digit) << (sizeof(limb_t) * 8);
+            num |= lhs[i];
+            lhs_digit = num % rhs;
+            if (lhs_digit >= rhs)
+            {
+                lhs_digit = lhs_digit % rhs;
+            }
+        }
+        return lhs_digit;
+    }
+
+    static constexpr limb_t largest_base10_numerator_fitting_in_limb()
+    {
+        constexpr limb_double_t limit = static_cast<limb_double_t>(1) << (sizeof(limb_t) * 8);
+        limb_double_t n = 1;
+        while (n < limit)
+        {
+            n *= 10;
+        }
+        return static_cast<limb_t>(n / 10);
+    }
+
+    static constexpr int largest_base10_numerator_fitting_in_limb_size()
+    {
+        constexpr limb_double_t limit = static_cast<limb_double_t>(1) << (sizeof(limb_t) * 8);
+        limb_double_t n = 1;
+        int result = 0;
+        while (n < limit)
+        {
+            n *= 10;
+            result++;
+        }
+        return result - 1;
+    }
+
+    // same contract as algorithm_d, recursive once both the rhs and the quotient are big enough, through a reciprocal
+    // for the biggest ones
+    template <bool ignore_quotient, bool ignore_remainder>
+    static int divide_multi_limb(limb_t * quotient, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, limb_t * remainder, int * remainder_size, scratch & workspace)
+    {
+        // the reciprocal costs about as much as a recursive division with a quotient of rhs_size limbs
+        if (rhs_size >= NEWTON_DIVISION_THRESHOLD && lhs_size - rhs_size >= rhs_size * 2)
+            return divide_by_blocks<ignore_quotient, ignore_remainder>(quotient, lhs, rhs, lhs_size, rhs_size, remainder, remainder_size, true, workspace);
+        if (rhs_size >= BURNIKEL_ZIEGLER_THRESHOLD && lhs_size - rhs_size >= BURNIKEL_ZIEGLER_THRESHOLD)
+            return divide_by_blocks<ignore_quotient, ignore_remainder>(quotient, lhs, rhs, lhs_size, rhs_size, remainder, remainder_size, false, workspace);
+        return algorithm_d<ignore_quotient, ignore_remainder>(quotient, lhs, rhs, lhs_size, rhs_size, remainder, remainder_size, workspace);
+    }
+
+    // quotient capacity must be at least lhs_size - rhs_size + 1 and remainder capacity at least rhs_size
+    // lhs must not be smaller than rhs, returns the size of the quotient
+    static int divide(limb_t * quotient, limb_t * remainder, int * remainder_size, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, scratch & workspace)
+    {
+        if (rhs_size > 1)
+            return divide_multi_limb<false, false>(quotient, lhs, rhs, lhs_size, rhs_size, remainder, remainder_size, workspace);
+        *remainder_size = 1;
+        return divide_by_one_digit(quotient, lhs, *rhs, lhs_size, remainder);
+    }
+
+    // non-negative matrix of determinant one kept row by row, (a, b) before the steps = matrix * (a, b) after them,
+    // rows is 2 for the whole matrix, 1 for the cofactors of an extended gcd, which only need (m10, m11), and 0 when
+    // nothing is tracked, each entry has capacity limbs
+    struct gcd_matrix
+    {
+        limb_t * entries[4];
+        int sizes[4];
+        int rows;
+        int capacity;
+    };
+
+    static void gcd_matrix_init(gcd_matrix & matrix, limb_t * memory, int rows, int capacity)
+    {
+        matrix.rows = rows;
+        matrix.capacity = capacity;
+        for (int i = 0; i < rows * 2; ++i)
+        {
+            matrix.entries[i] = memory + capacity * i;
+            matrix.entries[i][0] = (i == 0 || i == 3) ? 1 : 0;
+            matrix.sizes[i] = 1;
+        }
+        // the single row of the cofactors is the second one
+        if (rows == 1)
+        {
+            matrix.entries[0][0] = 0;
+            matrix.entries[1][0] = 1;
+        }
+    }
+
+    // digits >> shift truncated to two limbs
+    static limb_double_t extract_double(limb_t const * digits, int size, int shift)
+    {
+        constexpr int limb_bits = sizeof(limb_t) * 8;
+        int const index = shift / limb_bits;
+        int const bits = shift % limb_bits;
+        limb_t const digit0 = index < size ? digits[index] : 0;
+        limb_t const digit1 = index + 1 < size ? digits[index + 1] : 0;
+        limb_t const digit2 = index + 2 < size ? digits[index + 2] : 0;
+        limb_t const low = bits == 0 ? digit0 : (digit0 >> bits) | (digit1 << (limb_bits - bits));
+        limb_t const high = bits == 0 ? digit1 : (digit1 >> bits) | (digit2 << (limb_bits - bits));
+        return (static_cast<limb_double_t>(high) << limb_bits) | low;
+    }
+
+    // euclid steps on x and y, the high limbs of a and b at the same shift, keeping both of them at least bound:
+    // with a bound of base every entry of the matrix is below base and below x and y, so that the steps keep a and b
+    // positive whatever their low limbs, a bound of zero is only valid for exact single limb values
+    // returns false when no step is possible
+    static bool lehmer_matrix(limb_t * matrix, limb_double_t x, limb_double_t y, limb_double_t bound)
+    {
+        limb_t m00 = 1;
+        limb_t m01 = 0;
+        limb_t m10 = 0;
+        limb_t m11 = 1;
+        bool reduced = false;
+
+        for (;;)
+        {
+            if (x >= y)
+            {
+                if (y == 0)
+                    break;
+                limb_double_t remainder = x - y;
+                limb_double_t quotient = 1;
+                if (remainder >= y)
+                {
+                    quotient = x / y;
+                    remainder = x - quotient * y;
+                }
+                if (remainder < bound)
+                    break;
+                x = remainder;
+                m01 += static_cast<limb_t>(quotient) * m00;
+                m11 += static_cast<limb_t>(quotient) * m10;
+            }
+            else
+            {
+                if (x == 0)
+                    break;
+                limb_double_t remainder = y - x;
+                limb_double_t quotient = 1;
+                if (remainder >= x)
+                {
+                    quotient = y / x;
+                    remainder = y - quotient * x;
+                }
+                if (remainder < bound)
+                    break;
+                y = remainder;
+                m00 += static_cast<limb_t>(quotient) * m01;
+                m10 += static_cast<limb_t>(quotient) * m11;
+            }
+            reduced = true;
+        }
+        matrix[0] = m00;
+        matrix[1] = m01;
+        matrix[2] = m10;
+        matrix[3] = m11;
+        return reduced;
+    }
+
+    // a = m11 * a - m01 * b and b = m00 * b - m10 * a in place, both of them known not to be negative
+    static void lehmer_update(limb_t * a, limb_t * b, int * a_size, int * b_size, limb_t const * matrix)
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        int const size = std::max(*a_size, *b_size);
+        for (int i = *a_size; i < size; ++i)
+            a[i] = 0;
+        for (int i = *b_size; i < size; ++i)
+            b[i] = 0;
+
+        limb_t carry00 = 0;
+        limb_t carry01 = 0;
+        limb_t carry10 = 0;
+        limb_t carry11 = 0;
+        limb_t a_borrow = 0;
+        limb_t b_borrow = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            limb_t const a_digit = a[i];
+            limb_t const b_digit = b[i];
+            limb_double_t const product00 = static_cast<limb_double_t>(b_digit) * matrix[0] + carry00;
+            limb_double_t const product01 = static_cast<limb_double_t>(b_digit) * matrix[1] + carry01;
+            limb_double_t const product10 = static_cast<limb_double_t>(a_digit) * matrix[2] + carry10;
+            limb_double_t const product11 = static_cast<limb_double_t>(a_digit) * matrix[3] + carry11;
+            carry00 = static_cast<limb_t>(product00 >> limb_bits);
+            carry01 = static_cast<limb_t>(product01 >> limb_bits);
+            carry10 = static_cast<limb_t>(product10 >> limb_bits);
+            carry11 = static_cast<limb_t>(product11 >> limb_bits);
+
+            // borrows taken from the double width differences, comparisons would branch on random data
+            limb_double_t const a_difference = static_cast<limb_double_t>(static_cast<limb_t>(product11)) - static_cast<limb_t>(product01) - a_borrow;
+            limb_double_t const b_difference = static_cast<limb_double_t>(static_cast<limb_t>(product00)) - static_cast<limb_t>(product10) - b_borrow;
+            a[i] = static_cast<limb_t>(a_difference);
+            b[i] = static_cast<limb_t>(b_difference);
+            a_borrow = static_cast<limb_t>(a_difference >> limb_bits) & 1;
+            b_borrow = static_cast<limb_t>(b_difference >> limb_bits) & 1;
+        }
+        assert(carry11 == carry01 + a_borrow && carry00 == carry10 + b_borrow);
+        *a_size = trimmed_size(a, size);
+        *b_size = trimmed_size(b, size);
+    }
+
+    // (x, y) = (x * m00 + y * m10, x * m01 + y * m11) in place, x and y need two more limbs than the biggest of them
+    static void lehmer_update_row(limb_t * x, limb_t * y, int * x_size, int * y_size, limb_t const * matrix)
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        int const size = std::max(*x_size, *y_size);
+        for (int i = *x_size; i < size; ++i)
+            x[i] = 0;
+        for (int i = *y_size; i < size; ++i)
+            y[i] = 0;
+
+        limb_t carry00 = 0;
+        limb_t carry01 = 0;
+        limb_t carry10 = 0;
+        limb_t carry11 = 0;
+        limb_t x_carry = 0;
+        limb_t y_carry = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            limb_t const x_digit = x[i];
+            limb_t const y_digit = y[i];
+            limb_double_t const product00 = static_cast<limb_double_t>(x_digit) * matrix[0] + carry00;
+            limb_double_t const product01 = static_cast<limb_double_t>(x_digit) * matrix[1] + carry01;
+            limb_double_t const product10 = static_cast<limb_double_t>(y_digit) * matrix[2] + carry10;
+            limb_double_t const product11 = static_cast<limb_double_t>(y_digit) * matrix[3] + carry11;
+            carry00 = static_cast<limb_t>(product00 >> limb_bits);
+            carry01 = static_cast<limb_t>(product01 >> limb_bits);
+            carry10 = static_cast<limb_t>(product10 >> limb_bits);
+            carry11 = static_cast<limb_t>(product11 >> limb_bits);
+
+            limb_double_t const x_sum = static_cast<limb_double_t>(static_cast<limb_t>(product00)) + static_cast<limb_t>(product10) + x_carry;
+            limb_double_t const y_sum = static_cast<limb_double_t>(static_cast<limb_t>(product01)) + static_cast<limb_t>(product11) + y_carry;
+            x[i] = static_cast<limb_t>(x_sum);
+            y[i] = static_cast<limb_t>(y_sum);
+            x_carry = static_cast<limb_t>(x_sum >> limb_bits);
+            y_carry = static_cast<limb_t>(y_sum >> limb_bits);
+        }
+        limb_double_t const x_high = static_cast<limb_double_t>(carry00) + carry10 + x_carry;
+        limb_double_t const y_high = static_cast<limb_double_t>(carry01) + carry11 + y_carry;
+        x[size] = static_cast<limb_t>(x_high);
+        y[size] = static_cast<limb_t>(y_high);
+        x[size + 1] = static_cast<limb_t>(x_high >> limb_bits);
+        y[size + 1] = static_cast<limb_t>(y_high >> limb_bits);
+        *x_size = trimmed_size(x, size + 2);
+        *y_size = trimmed_size(y, size + 2);
+    }
+
+    // target += source * factor, target capacity must hold the result
+    static int add_product(limb_t * target, int target_size, limb_t const * source, int source_size, limb_t const * factor, int factor_size, scratch & workspace)
+    {
+        size_t const mark = workspace.mark();
+        limb_t * const product = workspace.allocate(source_size + factor_size);
+        int const product_size = mul_with_scratch(product, source, factor, source_size, factor_size, workspace);
+        int const size = add(target, target, product, target_size, product_size);
+        workspace.release(mark);
+        return size;
+    }
+
+    // rows of matrix = rows of matrix * other
+    static void gcd_matrix_mul(gcd_matrix & matrix, gcd_matrix const & other, scratch & workspace)
+    {
+        for (int row = 0; row < matrix.rows; ++row)
+        {
+            limb_t * const x = matrix.entries[row * 2];
+            limb_t * const y = matrix.entries[row * 2 + 1];
+            int const x_size = matrix.sizes[row * 2];
+            int const y_size = matrix.sizes[row * 2 + 1];
+            size_t const mark = workspace.mark();
+            limb_t * const new_x = workspace.allocate(std::max(x_size + other.sizes[0], y_size + other.sizes[2]) + 1);
+            limb_t * const new_y = workspace.allocate(std::max(x_size + other.sizes[1], y_size + other.sizes[3]) + 1);
+            int new_x_size = mul_with_scratch(new_x, x, other.entries[0], x_size, other.sizes[0], workspace);
+            int new_y_size = mul_with_scratch(new_y, x, other.entries[1], x_size, other.sizes[1], workspace);
+            new_x_size = add_product(new_x, new_x_size, y, y_size, other.entries[2], other.sizes[2], workspace);
+            new_y_size = add_product(new_y, new_y_size, y, y_size, other.entries[3], other.sizes[3], workspace);
+            assert(new_x_size < matrix.capacity && new_y_size < matrix.capacity);
+            std::copy(new_x, new_x + new_x_size, x);
+            std::copy(new_y, new_y + new_y_size, y);
+            matrix.sizes[row * 2] = new_x_size;
+            matrix.sizes[row * 2 + 1] = new_y_size;
+            workspace.release(mark);
+        }
+    }
+
+    // digits = digits + plus - minus, which must not be negative
+    static int add_difference(limb_t * digits, int size, limb_t * plus, int plus_size, limb_t * minus, int minus_size)
+    {
+        if (compare(plus, minus, plus_size, minus_size) >= 0)
+        {
+            int const difference_size = sub(plus, plus, minus, plus_size, minus_size);
+            return add(digits, digits, plus, size, difference_size);
+        }
+        int const difference_size = sub(minus, minus, plus, minus_size, plus_size);
+        return sub(digits, digits, minus, size, difference_size);
+    }
+
+    // a and b hold the values reduced by matrix above their low limbs, which are still those of the values before the
+    // reduction, completes a = m11 * a - m01 * b and b = m00 * b - m10 * a from the low limbs
+    static void gcd_matrix_apply(gcd_matrix const & matrix, limb_t * a, limb_t * b, int * a_size, int * b_size, int low_size, scratch & workspace)
+    {
+        int const a_low_size = trimmed_size(a, low_size);
+        int const b_low_size = trimmed_size(b, low_size);
+        size_t const mark = workspace.mark();
+        limb_t * const a_plus = workspace.allocate(matrix.sizes[3] + a_low_size);
+        limb_t * const a_minus = workspace.allocate(matrix.sizes[1] + b_low_size);
+        limb_t * const b_plus = workspace.allocate(matrix.sizes[0] + b_low_size);
+        limb_t * const b_minus = workspace.allocate(matrix.sizes[2] + a_low_size);
+        int const a_plus_size = mul_with_scratch(a_plus, matrix.entries[3], a, matrix.sizes[3], a_low_size, workspace);
+        int const a_minus_size = mul_with_scratch(a_minus, matrix.entries[1], b, matrix.sizes[1], b_low_size, workspace);
+        int const b_plus_size = mul_with_scratch(b_plus, matrix.entries[0], b, matrix.sizes[0], b_low_size, workspace);
+        int const b_minus_size = mul_with_scratch(b_minus, matrix.entries[2], a, matrix.sizes[2], a_low_size, workspace);
+        std::fill(a, a + low_size, 0);
+        std::fill(b, b + low_size, 0);
+        *a_size = add_difference(a, *a_size, a_plus, a_plus_size, a_minus, a_minus_size);
+        *b_size = add_difference(b, *b_size, b_plus, b_plus_size, b_minus, b_minus_size);
+        workspace.release(mark);
+    }
+
+    // one lehmer step on the high limbs, or one division step when it cannot make progress, as long as both a and b
+    // stay at least base^bound, returns false when no step is possible, the smaller of a and b must not be zero
+    static bool gcd_step(gcd_matrix & matrix, limb_t * a, limb_t * b, int * a_size, int * b_size, int bound, scratch & workspace)
+    {
+        constexpr int limb_bits = sizeof(limb_t) * 8;
+        constexpr limb_double_t base = static_cast<limb_double_t>(1) << limb_bits;
+        bool const a_larger = compare(a, b, *a_size, *b_size) >= 0;
+        int const size = a_larger ? *a_size : *b_size;
+
+        // the high limbs of values of more than bound + 2 limbs stay above base^bound, smaller values are exact
+        if (size > bound + 2 || bound == 0)
+        {
+            int const shift = std::max(bit_length(a_larger ? a : b, size) - limb_bits * 2, 0);
+            limb_double_t const x = extract_double(a, *a_size, shift);
+            limb_double_t const y = extract_double(b, *b_size, shift);
+            limb_t lehmer[4];
+            if (lehmer_matrix(lehmer, x, y, (shift == 0 && std::max(x, y) < base) ? 0 : base))
+            {
+                lehmer_update(a, b, a_size, b_size, lehmer);
+                for (int row = 0; row < matrix.rows; ++row)
+                    lehmer_update_row(matrix.entries[row * 2], matrix.entries[row * 2 + 1], &matrix.sizes[row * 2], &matrix.sizes[row * 2 + 1], lehmer);
+                return true;
+            }
+        }
+
+        limb_t * const larger = a_larger ? a : b;
+        limb_t const * const smaller = a_larger ? b : a;
+        int * const larger_size = a_larger ? a_size : b_size;
+        int const smaller_size = a_larger ? *b_size : *a_size;
+        size_t const mark = workspace.mark();
+        limb_t * const remainder = workspace.allocate(smaller_size);
+        limb_t * const quotient = matrix.rows > 0 ? workspace.allocate(*larger_size - smaller_size + 1) : nullptr;
+        int remainder_size;
+        int quotient_size = 0;
+        if (matrix.rows > 0)
+            quotient_size = divide(quotient, remainder, &remainder_size, larger, smaller, *larger_size, smaller_size, workspace);
+        else
+            remainder_size = mod_with_scratch(remainder, larger, smaller, *larger_size, smaller_size, workspace);
+        if (bound > 0 && remainder_size <= bound)
+        {
+            workspace.release(mark);
+            return false;
+        }
+        std::copy(remainder, remainder + remainder_size, larger);
+        *larger_size = remainder_size;
+
+        // a -= q * b adds q times the first column to the second one, b -= q * a the other way around
+        for (int row = 0; row < matrix.rows; ++row)
+        {
+            int const target = row * 2 + (a_larger ? 1 : 0);
+            int const source = row * 2 + (a_larger ? 0 : 1);
+            matrix.sizes[target] = add_product(matrix.entries[target], matrix.sizes[target], matrix.entries[source], matrix.sizes[source], quotient, quotient_size, workspace);
+        }
+        workspace.release(mark);
+        return true;
+    }
+
+    // https://www.ams.org/journals/mcom/2008-77-261/S0025-5718-07-02017-0/S0025-5718-07-02017-0.pdf
+    // reduces a and b, below base^size, in place as long as both of them stay at least base^(size / 2 + 1), so that
+    // the entries of matrix stay below base^(size / 2) and the reduction of the high limbs of bigger values stays valid
+    // for them, matrix must be the identity with a capacity of at least size / 2 + 2, returns false when no step was possible
+    static bool half_gcd(gcd_matrix & matrix, limb_t * a, limb_t * b, int * a_size, int * b_size, int size, scratch & workspace)
+    {
+        int const bound = size / 2 + 1;
+        assert(matrix.rows == 2 && matrix.capacity >= size / 2 + 2);
+        if (*a_size <= bound || *b_size <= bound)
+            return false;
+
+        bool reduced = false;
+        if (size >= HALF_GCD_THRESHOLD)
+        {
+            // the high half reduces both values to about three quarters of size
+            int const low_size = size / 2;
+            int a_high_size = *a_size - low_size;
+            int b_high_size = *b_size - low_size;
+            if (half_gcd(matrix, a + low_size, b + low_size, &a_high_size, &b_high_size, size - low_size, workspace))
+            {
+                *a_size = a_high_size + low_size;
+                *b_size = b_high_size + low_size;
+                gcd_matrix_apply(matrix, a, b, a_size, b_size, low_size, workspace);
+                reduced = true;
+            }
+            if (!gcd_step(matrix, a, b, a_size, b_size, bound, workspace))
+                return reduced;
+            reduced = true;
+
+            // the high limbs above bound * 2 - current size + 1 reduce them to about bound
+            int const current_size = std::max(*a_size, *b_size);
+            int const second_low_size = bound * 2 - current_size + 1;
+            if (current_size - second_low_size >= 3)
+            {
+                int const high_size = current_size - second_low_size;
+                size_t const mark = workspace.mark();
+                gcd_matrix other;
+                gcd_matrix_init(other, workspace.allocate((high_size / 2 + 2) * 4), 2, high_size / 2 + 2);
+                a_high_size = *a_size - second_low_size;
+                b_high_size = *b_size - second_low_size;
+                if (half_gcd(other, a + second_low_size, b + second_low_size, &a_high_size, &b_high_size, high_size, workspace))
+                {
+                    *a_size = a_high_size + second_low_size;
+                    *b_size = b_high_size + second_low_size;
+                    gcd_matrix_apply(other, a, b, a_size, b_size, second_low_size, workspace);
+                    gcd_matrix_mul(matrix, other, workspace);
+                }
+                workspace.release(mark);
+            }
+        }
+        while (gcd_step(matrix, a, b, a_size, b_size, bound, workspace))
+            reduced = true;
+        return reduced;
+    }
+
+    // reduces a and b in place until one of them is zero, the other one being their gcd, the rows of cofactors follow
+    // the steps, the high two thirds of big values go through half_gcd, which reduces them by about a third
+    static void gcd_reduce(gcd_matrix & cofactors, limb_t * a, limb_t * b, int * a_size, int * b_size, scratch & workspace)
+    {
+        while (!(*a_size == 1 && *a == 0) && !(*b_size == 1 && *b == 0))
+        {
+            int const size = std::max(*a_size, *b_size);
+            int const low_size = size / 3;
+            if (std::min(*a_size, *b_size) - low_size >= SUBQUADRATIC_GCD_THRESHOLD)
+            {
+                int const high_size = size - low_size;
+                size_t const mark = workspace.mark();
+                gcd_matrix matrix;
+                gcd_matrix_init(matrix, workspace.allocate((high_size / 2 + 2) * 4), 2, high_size / 2 + 2);
+                int a_high_size = *a_size - low_size;
+                int b_high_size = *b_size - low_size;
+                bool const reduced = half_gcd(matrix, a + low_size, b + low_size, &a_high_size, &b_high_size, high_size, workspace);
+                if (reduced)
+                {
+                    *a_size = a_high_size + low_size;
+                    *b_size = b_high_size + low_size;
+                    gcd_matrix_apply(matrix, a, b, a_size, b_size, low_size, workspace);
+                    gcd_matrix_mul(cofactors, matrix, workspace);
+                }
+                workspace.release(mark);
+                if (reduced)
+                    continue;
+            }
+            gcd_step(cofactors, a, b, a_size, b_size, 0, workspace);
+        }
+    }
+
+    // result = gcd(lhs, rhs) and lhs * cofactor = result (mod rhs) with cofactor holding rhs_size + 2 limbs when wanted
+    static int extended_gcd(limb_t * result, limb_t * cofactor, int * cofactor_size, bool * cofactor_negative, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, scratch & workspace)
+    {
+        // the steps pad the smaller value up to the size of the bigger one
+        size_t const mark = workspace.mark();
+        limb_t * const a = workspace.allocate(std::max(lhs_size, rhs_size));
+        limb_t * const b = workspace.allocate(std::max(lhs_size, rhs_size));
+        std::copy(lhs, lhs + lhs_size, a);
+        std::copy(rhs, rhs + rhs_size, b);
+        gcd_matrix cofactors;
+        gcd_matrix_init(cofactors, cofactor == nullptr ? nullptr : workspace.allocate((rhs_size + 2) * 2), cofactor == nullptr ? 0 : 1, rhs_size + 2);
+        gcd_reduce(cofactors, a, b, &lhs_size, &rhs_size, workspace);
+
+        // with (lhs, rhs) = m * (a, b) and a determinant of one, a = m11 * lhs - m01 * rhs and b = m00 * rhs - m10 * lhs
+        bool const a_is_gcd = rhs_size == 1 && *b == 0;
+        int const size = a_is_gcd ? lhs_size : rhs_size;
+        std::copy(a_is_gcd ? a : b, (a_is_gcd ? a : b) + size, result);
+        if (cofactor != nullptr)
+        {
+            int const entry = a_is_gcd ? 1 : 0;
+            *cofactor_size = cofactors.sizes[entry];
+            std::copy(cofactors.entries[entry], cofactors.entries[entry] + *cofactor_size, cofactor);
+            *cofactor_negative = !a_is_gcd && !(*cofactor_size == 1 && *cofactor == 0);
+        }
+        workspace.release(mark);
+        return size;
+    }
+
+    // result capacity must be at least size * exponent, result must not be digits
+    static int power(limb_t * result, limb_t const * digits, int size, int exponent, scratch & workspace)
+    {
+        assert(exponent > 0);
+        size_t const mark = workspace.mark();
+        limb_t * current = result;
+        limb_t * next = workspace.allocate(size * exponent);
+        std::copy(digits, digits + size, current);
+        int current_size = size;
+
+        // left to right binary powering
+        int bit = 0;
+        while ((exponent >> bit) > 1)
+            bit++;
+        for (--bit; bit >= 0; --bit)
+        {
+            current_size = mul_with_scratch(next, current, current, current_size, current_size, workspace);
+            std::swap(current, next);
+            if (((exponent >> bit) & 1) != 0)
+            {
+                current_size = mul_with_scratch(next, current, digits, current_size, size, workspace);
+                std::swap(current, next);
+            }
+        }
+        if (current != result)
+            std::copy(current, current + current_size, result);
+        workspace.release(mark);
+        return current_size;
+    }
+
+    // result = ((k - 1) * root + digits / power) / k with power = root^(k - 1), which by the arithmetic and geometric
+    // means is never below the k-th root of digits rounded down, and is below root when root is above it
+    // result capacity must be at least root_size + 1, result can be root
+    static int root_newton_step(limb_t * result, limb_t const * root, int root_size, limb_t const * power, int power_size, limb_t const * digits, int size, int k, scratch & workspace)
+    {
+        size_t const mark = workspace.mark();
+        int const quotient_capacity = std::max(size - power_size + 1, 1);
+        limb_t * const quotient = workspace.allocate(quotient_capacity);
+        limb_t * const remainder = workspace.allocate(power_size);
+        limb_t * const sum = workspace.allocate(std::max(root_size + 1, quotient_capacity) + 1);
+        int quotient_size = 1;
+        *quotient = 0;
+        if (compare(digits, power, size, power_size) >= 0)
+        {
+            int remainder_size;
+            quotient_size = divide(quotient, remainder, &remainder_size, digits, power, size, power_size, workspace);
+        }
+        int sum_size = mul_by_one_digit(sum, root, root_size, static_cast<limb_t>(k - 1));
+        sum_size = add(sum, sum, quotient, sum_size, quotient_size);
+        limb_t rest;
+        sum_size = divide_by_one_digit(sum, sum, static_cast<limb_t>(k), sum_size, &rest);
+        std::copy(sum, sum + sum_size, result);
+        workspace.release(mark);
+        return sum_size;
+    }
+
+    // newton steps from a root not below the k-th root of digits rounded down, until its power fits in digits, which
+    // happens at the root rounded down, power_digits capacity must be at least root_size * (k - 1) and product
+    // capacity, unless it is nullptr, at least root_size * k, they end up holding root^(k - 1) and root^k
+    static int root_descend(limb_t * root, int root_size, limb_t * power_digits, limb_t * product, int * product_size, limb_t const * digits, int size, int k, scratch & workspace)
+    {
+        size_t const mark = workspace.mark();
+        if (product == nullptr)
+            product = workspace.allocate(root_size * k);
+        for (;;)
+        {
+            int const power_size = power(power_digits, root, root_size, k - 1, workspace);
+            int const current_size = mul_with_scratch(product, power_digits, root, power_size, root_size, workspace);
+            if (compare(product, digits, current_size, size) <= 0)
+            {
+                if (product_size != nullptr)
+                    *product_size = current_size;
+                break;
+            }
+            root_size = root_newton_step(root, root, root_size, power_digits, power_size, digits, size, k, workspace);
+        }
+        workspace.release(mark);
+        return root_size;
+    }
+
+    // writes a value no smaller than the k-th root of digits rounded down and about one above it at most
+    // result capacity must be at least size / k + 3, k must be at least 2
+    static int root_estimate(limb_t * result, limb_t const * digits, int size, int k, scratch & workspace)
+    {
+        constexpr int limb_bits = sizeof(limb_t) * 8;
+        int const root_bits = (bit_length(digits, size) + k - 1) / k;
+        int const capacity = size / k + 3;
+        int k_bits = 0;
+        while ((k >> k_bits) != 0)
+            k_bits++;
+
+        // from an estimate above the root by e, a newton step lands less than (k - 1) * e^2 / root above it, the root
+        // of the high bits of digits shifted back by low_bits is at most 3 * 2^low_bits above, which leaves below 1/2
+        int const low_bits = root_bits / 2 - k_bits - 2;
+        size_t const mark = workspace.mark();
+        limb_t * const power_digits = workspace.allocate(capacity * (k - 1));
+        limb_t * root = workspace.allocate(capacity);
+        int root_size;
+        if (low_bits >= limb_bits)
+        {
+            limb_t * const high = workspace.allocate(size);
+            int const high_size = shr(high, digits, size, low_bits * k);
+            limb_t * const high_root = workspace.allocate(high_size / k + 4);
+            int high_root_size = root_estimate(high_root, high, high_size, k, workspace);
+            high_root[high_root_size] = 0;
+            increment(high_root, high_root_size + 1);
+            high_root_size = trimmed_size(high_root, high_root_size + 1);
+            root_size = shl(root, high_root, high_root_size, low_bits);
+            assert(root_size <= capacity);
+            int const power_size = power(power_digits, root, root_size, k - 1, workspace);
+            root_size = root_newton_step(result, root, root_size, power_digits, power_size, digits, size, k, workspace);
+            workspace.release(mark);
+            return root_size;
+        }
+
+        // exp2(log2(digits) / k) from the high limbs, raised a little and rounded up to stay above the root
+        double high = 0;
+        int const low = std::max(size - 96 / limb_bits - 1, 0);
+        for (int i = size - 1; i >= low; --i)
+            high = std::ldexp(high, limb_bits) + static_cast<double>(digits[i]);
+        int exponent;
+        double const mantissa = std::frexp(std::exp2((std::log2(high) + static_cast<double>(low) * limb_bits) / k) * (1 + std::ldexp(1.0, -32)), &exponent);
+        ::uint64_t const estimate = static_cast< ::uint64_t>(std::ldexp(mantissa, 53));
+        root_size = 0;
+        for (int i = 0; i < static_cast<int>(sizeof(::uint64_t) / sizeof(limb_t)); ++i)
+            root[root_size++] = static_cast<limb_t>(estimate >> (i * limb_bits));
+        root_size = trimmed_size(root, root_size);
+        if (exponent > 53)
+            root_size = shl(root, root, root_size, exponent - 53);
+        else
+            root_size = shr(root, root, root_size, 53 - exponent);
+        root[root_size] = 0;
+        increment(root, root_size + 1);
+        root_size = trimmed_size(root, root_size + 1);
+
+        root_size = root_descend(root, root_size, power_digits, nullptr, nullptr, digits, size, k, workspace);
+        std::copy(root, root + root_size, result);
+        workspace.release(mark);
+        return root_size;
+    }
+
+    // result capacity must be at least count, count must be greater than zero and factors too
+    // the halves are multiplied recursively so that the operands of every multiplication have similar sizes
+    static int multiply_limbs(limb_t * result, limb_t const * factors, int count, scratch & workspace)
+    {
+        if (count <= PRODUCT_TREE_THRESHOLD)
+        {
+            *result = *factors;
+            int size = 1;
+            for (int i = 1; i < count; ++i)
+                size = mul_by_one_digit(result, result, size, factors[i]);
+            return size;
+        }
+        int const half = count / 2;
+        size_t const mark = workspace.mark();
+        limb_t * const lhs = workspace.allocate(half);
+        limb_t * const rhs = workspace.allocate(count - half);
+        int const lhs_size = multiply_limbs(lhs, factors, half, workspace);
+        int const rhs_size = multiply_limbs(rhs, factors + half, count - half, workspace);
+        int const size = mul_with_scratch(result, lhs, rhs, lhs_size, rhs_size, workspace);
+        workspace.release(mark);
+        return size;
+    }
+
+    // multiplies factor into the last limb of factors while it fits, and starts a new limb otherwise
+    static void pack_factor(limb_t * factors, int * count, limb_t factor)
+    {
+        if (*count > 0 && factors[*count - 1] <= static_cast<limb_t>(~static_cast<limb_t>(0)) / factor)
+            factors[*count - 1] *= factor;
+        else
+            factors[(*count)++] = factor;
+    }
+
+    // result = lhs * rhs / base^size mod modulus by coarsely integrated operand scanning, all of them size limbs below
+    // the odd modulus, inverse = -1 / modulus mod base and work holds size + 2 limbs, result can be lhs or rhs
+    static void montgomery_multiply(limb_t * result, limb_t const * lhs, limb_t const * rhs, limb_t const * modulus, limb_t inverse, int size, limb_t * work)
+    {
+        constexpr int bits = sizeof(limb_t) * 8;
+        for (int i = 0; i < size + 2; ++i)
+            work[i] = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            // work += lhs * rhs[i]
+            limb_t carry = 0;
+            for (int j = 0; j < size; ++j)
+            {
+                limb_double_t const product = static_cast<limb_double_t>(lhs[j]) * rhs[i] + work[j] + carry;
+                work[j] = static_cast<limb_t>(product);
+                carry = static_cast<limb_t>(product >> bits);
+            }
+            limb_double_t sum = static_cast<limb_double_t>(work[size]) + carry;
+            work[size] = static_cast<limb_t>(sum);
+            work[size + 1] = static_cast<limb_t>(sum >> bits);
+
+            // work = (work + factor * modulus) / base, the factor making the low limb zero
+            limb_t const factor = work[0] * inverse;
+            limb_double_t product = static_cast<limb_double_t>(factor) * modulus[0] + work[0];
+            carry = static_cast<limb_t>(product >> bits);
+            for (int j = 1; j < size; ++j)
+            {
+                product = static_cast<limb_double_t>(factor) * modulus[j] + work[j] + carry;
+                work[j - 1] = static_cast<limb_t>(product);
+                carry = static_cast<limb_t>(product >> bits);
+            }
+            sum = static_cast<limb_double_t>(work[size]) + carry;
+            work[size - 1] = static_cast<limb_t>(sum);
+            work[size] = work[size + 1] + static_cast<limb_t>(sum >> bits);
+        }
+
+        // work is below modulus * 2
+        if (work[size] != 0 || compare(work, modulus, size, size) >= 0)
+            sub_in_place(work, modulus, size);
+        for (int i = 0; i < size; ++i)
+            result[i] = work[i];
+    }
+
+    // result = digits / base^size mod modulus, digits being size limbs below the modulus, work holds size * 2 + 1 limbs
+    static void montgomery_reduce(limb_t * result, limb_t const * digits, limb_t const * modulus, limb_t inverse, int size, limb_t * work)
+    {
+        constexpr int bits = sizeof(limb_t) * 8;
+        for (int i = 0; i < size; ++i)
+            work[i] = digits[i];
+        for (int i = size; i < size * 2 + 1; ++i)
+            work[i] = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            limb_t const factor = work[i] * inverse;
+            limb_t carry = 0;
+            for (int j = 0; j < size; ++j)
+            {
+                limb_double_t const product = static_cast<limb_double_t>(factor) * modulus[j] + work[i + j] + carry;
+                work[i + j] = static_cast<limb_t>(product);
+                carry = static_cast<limb_t>(product >> bits);
+            }
+            for (int j = i + size; carry != 0; ++j)
+            {
+                work[j] += carry;
+                carry = work[j] < carry ? 1 : 0;
+            }
+        }
+        if (work[size * 2] != 0 || compare(work + size, modulus, size, size) >= 0)
+            sub_in_place(work + size, modulus, size);
+        for (int i = 0; i < size; ++i)
+            result[i] = work[size + i];
+    }
+
+    // bits of the sliding window, balancing the odd powers computed upfront against the multiplications saved
+    static int power_window(int exponent_bits)
+    {
+        if (exponent_bits <= 8)
+            return 1;
+        if (exponent_bits <= 36)
+            return 2;
+        if (exponent_bits <= 140)
+            return 3;
+        if (exponent_bits <= 450)
+            return 4;
+        if (exponent_bits <= 1300)
+            return 5;
+        return 6;
+    }
+
+    static bool exponent_bit(limb_t const * exponent, int bit)
+    {
+        constexpr int bits = sizeof(limb_t) * 8;
+        return ((exponent[bit / bits] >> (bit % bits)) & 1) != 0;
+    }
+
+    // result = base^exponent with left to right sliding windows, every value being size limbs and multiply(result, lhs, rhs)
+    // allowing result to be one of its operands, exponent must be trimmed and greater than zero, table holds
+    // size << (window - 1) limbs for the odd powers of base
+    template <typename multiply_t>
+    static void sliding_window_power(limb_t * result, limb_t const * base, limb_t const * exponent, int exponent_size, int size, int window, limb_t * table, multiply_t multiply)
+    {
+        constexpr int bits = sizeof(limb_t) * 8;
+        int bit = exponent_size * bits - 1 - static_cast<int>(bits - 1 - de_bruijn(exponent[exponent_size - 1]));
+
+        // table[i] = base^(i * 2 + 1)
+        for (int i = 0; i < size; ++i)
+            table[i] = base[i];
+        if (window > 1)
+        {
+            multiply(result, base, base);
+            for (int i = 1; i < 1 << (window - 1); ++i)
+                multiply(table + i * size, table + (i - 1) * size, result);
+        }
+
+        bool first = true;
+        while (bit >= 0)
+        {
+            if (!exponent_bit(exponent, bit))
+            {
+                multiply(result, result, result);
+                --bit;
+                continue;
+            }
+
+            // the longest window of at most window bits ending on a set bit
+            int low = std::max(bit - window + 1, 0);
+            while (!exponent_bit(exponent, low))
+                ++low;
+            int value = 0;
+            for (int i = bit; i >= low; --i)
+                value = (value << 1) | (exponent_bit(exponent, i) ? 1 : 0);
+
+            limb_t const * const power = table + (value >> 1) * size;
+            if (first)
+            {
+                for (int i = 0; i < size; ++i)
+                    result[i] = power[i];
+                first = false;
+            }
+            else
+            {
+                for (int i = low; i <= bit; ++i)
+                    multiply(result, result, result);
+                multiply(result, result, power);
+            }
+            bit = low - 1;
+        }
+    }
+
+    struct base10_power
+    {
+        limb_t * digits;
+        int size;
+    };
+
+    // 10^(numerator_size * 2^k), squared on demand and kept until exit, allocated with malloc so that the table
+    // does not depend on set_allocator, entries below g_base10_power_count are never modified again
+    static base10_power g_base10_powers[32];
+    static std::atomic<int> g_base10_power_count(0);
+    static std::mutex g_base10_power_mutex;
+
+    static base10_power const & get_base10_power(int k)
+    {
+        assert(k < 32);
+        if (k < g_base10_power_count.load(std::memory_order_acquire))
+            return g_base10_powers[k];
+
+        std::lock_guard<std::mutex> lock(g_base10_power_mutex);
+        int count = g_base10_power_count.load(std::memory_order_relaxed);
+        if (count == 0)
+        {
+            g_base10_powers[0].digits = static_cast<limb_t *>(::malloc(sizeof(limb_t)));
+            g_base10_powers[0].digits[0] = largest_base10_numerator_fitting_in_limb();
+            g_base10_powers[0].size = 1;
+            count = 1;
+        }
+        for (; count <= k; ++count)
+        {
+            base10_power const & previous = g_base10_powers[count - 1];
+            limb_t * const digits = static_cast<limb_t *>(::malloc(sizeof(limb_t) * previous.size * 2));
+            g_base10_powers[count].size = sqr(digits, previous.digits, previous.size);
+            g_base10_powers[count].digits = digits;
+        }
+        g_base10_power_count.store(count, std::memory_order_release);
+        return g_base10_powers[k];
+    }
+
+    // writes digits, which must not be bigger than TO_BASE10_THRESHOLD limbs, as exactly width characters padded with
+    // leading zeros, or without padding when width is zero, returns the number of characters written
+    static int to_base10_basecase(char * str, int width, limb_t const * digits, int size)
+    {
+        constexpr limb_t numerator = largest_base10_numerator_fitting_in_limb();
+        constexpr int numerator_size = largest_base10_numerator_fitting_in_limb_size();
+        static limb_divisor const divisor(numerator);
+        char buffer[(TO_BASE10_THRESHOLD + 1) * (numerator_size + 1)];
+        limb_t copy[TO_BASE10_THRESHOLD];
+        int len = 0;
+
+        assert(size <= TO_BASE10_THRESHOLD);
+        for (int i = 0; i < size; ++i)
+            copy[i] = digits[i];
+        while (size > 1 || *copy >= numerator)
+        {
+            limb_t remainder;
+            size = divisor.divide(copy, copy, size, &remainder);
+            for (int i = 0; i < numerator_size; ++i)
+            {
+                buffer[len++] = (remainder % 10) + '0';
+                remainder /= 10;
+            }
+        }
+        while (*copy > 0)
+        {
+            buffer[len++] = (*copy % 10) + '0';
+            *copy /= 10;
+        }
+        int const padding = std::max(width - len, 0);
+        for (int i = 0; i < padding; ++i)
+            str[i] = '0';
+        for (int i = 0; i < len; ++i)
+            str[padding + i] = buffer[len - 1 - i];
+        return padding + len;
+    }
+
+    // digits must be below 10^(numerator_size * 2^k), writes exactly numerator_size * 2^k characters
+    static void to_base10_padded(char * str, limb_t const * digits, int size, int k, scratch & workspace)
+    {
+        constexpr int numerator_size = largest_base10_numerator_fitting_in_limb_size();
+        int const width = numerator_size << k;
+
+        if (size <= TO_BASE10_THRESHOLD)
+        {
+            to_base10_basecase(str, width, digits, size);
+            return;
+        }
+
+        // digits = high * 10^(width / 2) + low
+        base10_power const & power = get_base10_power(k - 1);
+        if (size < power.size)
+        {
+            for (int i = 0; i < width / 2; ++i)
+                str[i] = '0';
+            to_base10_padded(str + width / 2, digits, size, k - 1, workspace);
+            return;
+        }
+        size_t const mark = workspace.mark();
+        limb_t * const high = workspace.allocate(size - power.size + 1 + power.size);
+        limb_t * const low = high + size - power.size + 1;
+        int low_size;
+        int const high_size = divide(high, low, &low_size, digits, power.digits, size, power.size, workspace);
+        to_base10_padded(str, high, high_size, k - 1, workspace);
+        to_base10_padded(str + width / 2, low, low_size, k - 1, workspace);
+        workspace.release(mark);
+    }
+
+    // returns the number of characters written, without leading zeros
+    static int to_base10_recursive(char * str, limb_t const * digits, int size, scratch & workspace)
+    {
+        if (size <= TO_BASE10_THRESHOLD)
+            return to_base10_basecase(str, 0, digits, size);
+
+        // largest k such that 10^(numerator_size * 2^k) <= digits, which makes the high part smaller than it too
+        int k = 0;
+        while (get_base10_power(k).size * 2 - 1 <= size)
+        {
+            base10_power const & next = get_base10_power(k + 1);
+            if (compare(next.digits, digits, next.size, size) > 0)
+                break;
+            ++k;
+        }
+
+        base10_power const & power = get_base10_power(k);
+        size_t const mark = workspace.mark();
+        limb_t * const high = workspace.allocate(size - power.size + 1 + power.size);
+        limb_t * const low = high + size - power.size + 1;
+        int low_size;
+        int const high_size = divide(high, low, &low_size, digits, power.digits, size, power.size, workspace);
+        int const len = to_base10_recursive(str, high, high_size, workspace);
+        to_base10_padded(str + len, low, low_size, k, workspace);
+        workspace.release(mark);
+        return len + (largest_base10_numerator_fitting_in_limb_size() << k);
+    }
+
+    // parses count decimal characters, at most numerator_size, returns false on a non digit character
+    static bool parse_base10_chunk(char const * str, int count, limb_t * value)
+    {
+        constexpr ::uint64_t ascii_zeros = 0x3030303030303030;
+        constexpr ::uint64_t high_nibbles = 0xf0f0f0f0f0f0f0f0;
+        limb_t result = 0;
+        int i = 0;
+
+        // eight characters at a time, the first one in the lowest byte
+        for (; i + 8 <= count; i += 8)
+        {
+            ::uint64_t block = 0;
+            for (int j = 0; j < 8; ++j)
+                block |= static_cast<::uint64_t>(static_cast<unsigned char>(str[i + j])) << (j * 8);
+            // digits are 0x30 to 0x39, adding 6 carries into the high nibble of anything above 0x39
+            if ((block & high_nibbles) != ascii_zeros || ((block + 0x0606060606060606) & high_nibbles) != ascii_zeros)
+                return false;
+            block -= ascii_zeros;
+            block = (block * 10 + (block >> 8)) & 0x00ff00ff00ff00ff;
+            block = (block * 100 + (block >> 16)) & 0x0000ffff0000ffff;
+            block = (block * 10000 + (block >> 32)) & 0xffffffff;
+            result = result * 100000000 + static_cast<limb_t>(block);
+        }
+        for (; i < count; ++i)
+        {
+            limb_t const digit = str[i] - '0';
+            if (digit >= 10)
+                return false;
+            result = result * 10 + digit;
+        }
+        *value = result;
+        return true;
+    }
+
+    // one chunk of numerator_size characters per multiply and add pass, returns the size of the result or -1
+    static int from_base10_basecase(limb_t * digits, char const * str, int length)
+    {
+        constexpr limb_t numerator = largest_base10_numerator_fitting_in_limb();
+        constexpr int numerator_size = largest_base10_numerator_fitting_in_limb_size();
+        int result_size = 1;
+        int chunk_size = length % numerator_size == 0 ? numerator_size : length % numerator_size;
+
+        *digits = 0;
+        for (int i = 0; i < length; i += chunk_size, chunk_size = numerator_size)
+        {
+            limb_t carry;
+            if (!parse_base10_chunk(str + i, chunk_size, &carry))
+                return -1;
+            for (int j = 0; j < result_size; ++j)
+            {
+                limb_double_t const product = carry + static_cast<limb_double_t>(digits[j]) * numerator;
+                digits[j] = static_cast<limb_t>(product);
+                carry = static_cast<limb_t>(product >> (sizeof(limb_t) * 8));
+            }
+            if (carry > 0)
+            {
+                digits[result_size] = carry;
+                result_size++;
+            }
+        }
+        return result_size;
+    }
+
+    // digits capacity must be at least ceil(length / numerator_size), returns the size of the result or -1
+    static int from_base10_recursive(limb_t * digits, char const * str, int length, scratch & workspace)
+    {
+        constexpr int numerator_size = largest_base10_numerator_fitting_in_limb_size();
+        if (length <= FROM_BASE10_THRESHOLD * numerator_size)
+            return from_base10_basecase(digits, str, length);
+
+        // value = high * 10^low_length + low, with low_length the largest numerator_size * 2^k below length
+        int k = 0;
+        while ((numerator_size << (k + 1)) < length)
+            ++k;
+        int const low_length = numerator_size << k;
+        int const high_length = length - low_length;
+        base10_power const & power = get_base10_power(k);
+
+        int const high_capacity = (high_length + numerator_size - 1) / numerator_size;
+        int const low_capacity = 1 << k;
+        size_t const mark = workspace.mark();
+        limb_t * const high = workspace.allocate(high_capacity * 2 + power.size + low_capacity);
+        limb_t * const shifted = high + high_capacity;
+        limb_t * const low = shifted + high_capacity + power.size;
+
+        int result_size = -1;
+        int const high_size = from_base10_recursive(high, str, high_length, workspace);
+        int const low_size = high_size < 0 ? -1 : from_base10_recursive(low, str + high_length, low_length, workspace);
+        if (low_size > 0)
+        {
+            int const shifted_size = mul_with_scratch(shifted, high, power.digits, high_size, power.size, workspace);
+            result_size = add(digits, shifted, low, shifted_size, low_size);
+        }
+        workspace.release(mark);
+        return result_size;
+    }
+
+    static constexpr int LIMB_HEX_CHARACTERS = sizeof(limb_t) * 2;
+
+    static char const g_hex_characters[] = "0123456789abcdef";
+
+    // value of every character, 16 for non hexadecimal ones
+    struct hex_table
+    {
+        unsigned char values[256];
+
+        constexpr hex_table()
+            : values()
+        {
+            for (int i = 0; i < 256; ++i)
+                values[i] = 16;
+            for (int i = 0; i < 10; ++i)
+                values['0' + i] = static_cast<unsigned char>(i);
+            for (int i = 0; i < 6; ++i)
+            {
+                values['a' + i] = static_cast<unsigned char>(i + 10);
+                values['A' + i] = static_cast<unsigned char>(i + 10);
+            }
+        }
+    };
+
+    static constexpr hex_table g_hex_table;
+
+    static limb_t hex_value(char c)
+    {
+        return g_hex_table.values[static_cast<unsigned char>(c)];
+    }
+
+    // count limbs of LIMB_HEX_CHARACTERS characters each, most significant first, into digits[count - 1] down to digits[0]
+    static bool parse_hex_limbs_scalar(limb_t * digits, char const * str, int count)
+    {
+        limb_t invalid = 0;
+        for (int i = count - 1; i >= 0; --i)
+        {
+            limb_t digit = 0;
+            for (int j = 0; j < LIMB_HEX_CHARACTERS; ++j)
+            {
+                limb_t const value = hex_value(*str++);
+                invalid |= value;
+                digit = (digit << 4) | (value & 0xf);
+            }
+            digits[i] = digit;
+        }
+        return invalid < 16;
+    }
+
+    // digits[count - 1] down to digits[0] as LIMB_HEX_CHARACTERS characters each
+    static void format_hex_limbs_scalar(char * str, limb_t const * digits, int count)
+    {
+        for (int i = count - 1; i >= 0; --i)
+        {
+            for (int shift = static_cast<int>(sizeof(limb_t) * 8) - 4; shift >= 0; shift -= 4)
+                *str++ = g_hex_characters[(digits[i] >> shift) & 0xf];
+        }
+    }
+
+#if defined(BIGINT_X86_SIMD)
+    // the simd kernels see the limbs as a little endian byte string and handle 8 bytes (16 characters) per block
+
+    __attribute__((target("sse4.1")))
+    static bool parse_hex16_sse41(char const * str, ::uint64_t * value)
+    {
+        __m128i const characters = _mm_loadu_si128(reinterpret_cast<__m128i const *>(str));
+        __m128i const digit = _mm_sub_epi8(characters, _mm_set1_epi8('0'));
+        __m128i const letter = _mm_sub_epi8(_mm_or_si128(characters, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i const is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+        __m128i const is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+        if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xffff)
+            return false;
+
+        // nibble pairs to bytes, most significant first, then byte swapped into a 64-bit value
+        __m128i const nibbles = _mm_blendv_epi8(_mm_add_epi8(letter, _mm_set1_epi8(10)), digit, is_digit);
+        __m128i const bytes = _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110));
+        *value = __builtin_bswap64(static_cast<::uint64_t>(_mm_cvtsi128_si64(_mm_packus_epi16(bytes, bytes))));
+        return true;
+    }
+
+    __attribute__((target("sse4.1")))
+    static void format_hex16_sse41(char * str, ::uint64_t value)
+    {
+        __m128i const bytes = _mm_cvtsi64_si128(static_cast<long long>(__builtin_bswap64(value)));
+        __m128i const high = _mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi8(0x0f));
+        __m128i const low = _mm_and_si128(bytes, _mm_set1_epi8(0x0f));
+        __m128i const table = _mm_loadu_si128(reinterpret_cast<__m128i const *>(g_hex_characters));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(str), _mm_shuffle_epi8(table, _mm_unpacklo_epi8(high, low)));
+    }
+
+    __attribute__((target("sse4.1")))
+    static bool parse_hex_bytes_sse41(unsigned char * bytes, char const * str, int count)
+    {
+        for (; count >= 8; str += 16)
+        {
+            ::uint64_t value;
+            if (!parse_hex16_sse41(str, &value))
+                return false;
+            count -= 8;
+            ::memcpy(bytes + count, &value, 8);
+        }
+        for (; count > 0; str += 2)
+        {
+            limb_t const high = hex_value(str[0]);
+            limb_t const low = hex_value(str[1]);
+            if ((high | low) >= 16)
+                return false;
+            bytes[--count] = static_cast<unsigned char>((high << 4) | low);
+        }
+        return true;
+    }
+
+    __attribute__((target("sse4.1")))
+    static void format_hex_bytes_sse41(char * str, unsigned char const * bytes, int count)
+    {
+        for (; count >= 8; str += 16)
+        {
+            ::uint64_t value;
+            count -= 8;
+            ::memcpy(&value, bytes + count, 8);
+            format_hex16_sse41(str, value);
+        }
+        for (; count > 0; str += 2)
+        {
+            unsigned char const byte = bytes[--count];
+            str[0] = g_hex_characters[byte >> 4];
+            str[1] = g_hex_characters[byte & 0xf];
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static bool parse_hex_bytes_avx2(unsigned char * bytes, char const * str, int count)
+    {
+        for (; count >= 16; str += 32)
+        {
+            __m256i const characters = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(str));
+            __m256i const digit = _mm256_sub_epi8(characters, _mm256_set1_epi8('0'));
+            __m256i const letter = _mm256_sub_epi8(_mm256_or_si256(characters, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+            __m256i const is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+            __m256i const is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+            if (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter)) != -1)
+                return false;
+
+            // each 128-bit lane packs its 16 characters into the low 8 bytes
+            __m256i const nibbles = _mm256_blendv_epi8(_mm256_add_epi8(letter, _mm256_set1_epi8(10)), digit, is_digit);
+            __m256i const pairs = _mm256_maddubs_epi16(nibbles, _mm256_set1_epi16(0x0110));
+            __m256i const packed = _mm256_packus_epi16(pairs, pairs);
+            ::uint64_t const high = __builtin_bswap64(static_cast<::uint64_t>(_mm256_extract_epi64(packed, 0)));
+            ::uint64_t const low = __builtin_bswap64(static_cast<::uint64_t>(_mm256_extract_epi64(packed, 2)));
+            count -= 16;
+            ::memcpy(bytes + count, &low, 8);
+            ::memcpy(bytes + count + 8, &high, 8);
+        }
+        return parse_hex_bytes_sse41(bytes, str, count);
+    }
+
+    __attribute__((target("avx2")))
+    static void format_hex_bytes_avx2(char * str, unsigned char const * bytes, int count)
+    {
+        __m256i const table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const *>(g_hex_characters)));
+        for (; count >= 16; str += 32)
+        {
+            ::uint64_t low;
+            ::uint64_t high;
+            count -= 16;
+            ::memcpy(&low, bytes + count, 8);
+            ::memcpy(&high, bytes + count + 8, 8);
+            __m128i const high_bytes = _mm_cvtsi64_si128(static_cast<long long>(__builtin_bswap64(high)));
+            __m128i const low_bytes = _mm_cvtsi64_si128(static_cast<long long>(__builtin_bswap64(low)));
+            __m256i const values = _mm256_inserti128_si256(_mm256_castsi128_si256(high_bytes), low_bytes, 1);
+            __m256i const high_nibbles = _mm256_and_si256(_mm256_srli_epi16(values, 4), _mm256_set1_epi8(0x0f));
+            __m256i const low_nibbles = _mm256_and_si256(values, _mm256_set1_epi8(0x0f));
+            __m256i const nibbles = _mm256_unpacklo_epi8(high_nibbles, low_nibbles);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(str), _mm256_shuffle_epi8(table, nibbles));
+        }
+        format_hex_bytes_sse41(str, bytes, count);
+    }
+
+    static bool parse_hex_limbs_sse41(limb_t * digits, char const * str, int count)
+    {
+        return parse_hex_bytes_sse41(reinterpret_cast<unsigned char *>(digits), str, count * static_cast<int>(sizeof(limb_t)));
+    }
+
+    static void format_hex_limbs_sse41(char * str, limb_t const * digits, int count)
+    {
+        format_hex_bytes_sse41(str, reinterpret_cast<unsigned char const *>(digits), count * static_cast<int>(sizeof(limb_t)));
+    }
+
+    static bool parse_hex_limbs_avx2(limb_t * digits, char const * str, int count)
+    {
+        return parse_hex_bytes_avx2(reinterpret_cast<unsigned char *>(digits), str, count * static_cast<int>(sizeof(limb_t)));
+    }
+
+    static void format_hex_limbs_avx2(char * str, limb_t const * digits, int count)
+    {
+        format_hex_bytes_avx2(str, reinterpret_cast<unsigned char const *>(digits), count * static_cast<int>(sizeof(limb_t)));
+    }
+#endif
+
+    struct hex_kernels
+    {
+        bool (*parse)(limb_t * digits, char const * str, int count);
+        void (*format)(char * str, limb_t const * digits, int count);
+    };
+
+    static hex_kernels select_hex_kernels()
+    {
+#if defined(BIGINT_X86_SIMD)
+        if (__builtin_cpu_supports("avx2"))
+            return { parse_hex_limbs_avx2, format_hex_limbs_avx2 };
+        if (__builtin_cpu_supports("sse4.1"))
+            return { parse_hex_limbs_sse41, format_hex_limbs_sse41 };
+#endif
+        return { parse_hex_limbs_scalar, format_hex_limbs_scalar };
+    }
+
+    static hex_kernels const & get_hex_kernels()
+    {
+        static hex_kernels const kernels = select_hex_kernels();
+        return kernels;
+    }
+
+    // batches keep limb i of number j at i * count + j, the kernels below run over the numbers in [first, last)
+    // the scalar ones go limb by limb across the numbers, keeping one carry per number, to read the limbs in order
+    static void batch_add_scalar(limb_t * result, limb_t const * lhs, limb_t const * rhs, int count, int size, int result_size, int first, int last)
+    {
+        if (first == last)
+            return;
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        limb_t * const carries = workspace.allocate(last - first);
+        std::fill(carries, carries + (last - first), 0);
+        for (int i = 0; i < size; ++i)
+        {
+            for (int j = first; j < last; ++j)
+            {
+                limb_t const lhs_digit = lhs[i * count + j];
+                limb_t const sum = lhs_digit + rhs[i * count + j];
+                limb_t const digit = sum + carries[j - first];
+                carries[j - first] = (sum < lhs_digit ? 1 : 0) | (digit < sum ? 1 : 0);
+                result[i * count + j] = digit;
+            }
+        }
+        if (result_size > size)
+            std::copy(carries, carries + (last - first), result + size * count + first);
+        workspace.release(mark);
+    }
+
+    static void batch_sub_scalar(limb_t * result, limb_t const * lhs, limb_t const * rhs, int count, int size, int result_size, int first, int last)
+    {
+        if (first == last)
+            return;
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        limb_t * const borrows = workspace.allocate(last - first);
+        std::fill(borrows, borrows + (last - first), 0);
+        for (int i = 0; i < size; ++i)
+        {
+            for (int j = first; j < last; ++j)
+            {
+                limb_t const lhs_digit = lhs[i * count + j];
+                limb_t const rhs_digit = rhs[i * count + j];
+                limb_t const difference = lhs_digit - rhs_digit;
+                limb_t const digit = difference - borrows[j - first];
+                borrows[j - first] = (lhs_digit < rhs_digit ? 1 : 0) | (difference < digit ? 1 : 0);
+                result[i * count + j] = digit;
+            }
+        }
+        if (result_size > size)
+            std::copy(borrows, borrows + (last - first), result + size * count + first);
+        workspace.release(mark);
+    }
+
+    static void batch_mul_scalar(limb_t * result, limb_t const * lhs, limb_t const * rhs, int count, int size, int result_size, int first, int last)
+    {
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        limb_t * const lhs_digits = workspace.allocate(size);
+        limb_t * const rhs_digits = workspace.allocate(size);
+        limb_t * const product = workspace.allocate(size * 2);
+        for (int j = first; j < last; ++j)
+        {
+            for (int i = 0; i < size; ++i)
+            {
+                lhs_digits[i] = lhs[i * count + j];
+                rhs_digits[i] = rhs[i * count + j];
+            }
+            int const product_size = mul_with_scratch(product, lhs_digits, rhs_digits, trimmed_size(lhs_digits, size), trimmed_size(rhs_digits, size), workspace);
+            for (int i = 0; i < result_size; ++i)
+                result[i * count + j] = i < product_size ? product[i] : 0;
+        }
+        workspace.release(mark);
+    }
+
+    static void batch_compare_scalar(int * results, limb_t const * lhs, limb_t const * rhs, int count, int size, int first, int last)
+    {
+        for (int j = first; j < last; ++j)
+        {
+            int i = size - 1;
+            while (i > 0 && lhs[i * count + j] == rhs[i * count + j])
+                i--;
+            limb_t const lhs_digit = lhs[i * count + j];
+            limb_t const rhs_digit = rhs[i * count + j];
+            results[j] = lhs_digit < rhs_digit ? -1 : (lhs_digit > rhs_digit ? 1 : 0);
+        }
+    }
+
+#if defined(BIGINT_X86_SIMD)
+    // unsigned lane comparisons go through the signed ones with the sign bits flipped
+#if defined(BIGINT_LIMB_64)
+    __attribute__((target("avx2")))
+    static inline __m256i lanes_add(__m256i lhs, __m256i rhs)
+    {
+        return _mm256_add_epi64(lhs, rhs);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i lanes_sub(__m256i lhs, __m256i rhs)
+    {
+        return _mm256_sub_epi64(lhs, rhs);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i lanes_less(__m256i lhs, __m256i rhs)
+    {
+        __m256i const sign = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+        return _mm256_cmpgt_epi64(_mm256_xor_si256(rhs, sign), _mm256_xor_si256(lhs, sign));
+    }
+#else
+    __attribute__((target("avx2")))
+    static inline __m256i lanes_add(__m256i lhs, __m256i rhs)
+    {
+        return _mm256_add_epi32(lhs, rhs);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i lanes_sub(__m256i lhs, __m256i rhs)
+    {
+        return _mm256_sub_epi32(lhs, rhs);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i lanes_less(__m256i lhs, __m256i rhs)
+    {
+        __m256i const sign = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+        return _mm256_cmpgt_epi32(_mm256_xor_si256(rhs, sign), _mm256_xor_si256(lhs, sign));
+    }
+#endif
+
+    // carries are kept as all ones lane masks, subtracting one adds the carry
+    __attribute__((target("avx2")))
+    static void batch_add_avx2(limb_t * result, limb_t const * lhs, limb_t const * rhs, int count, int size, int result_size, int first, int last)
+    {
+        constexpr int lanes = sizeof(__m256i) / sizeof(limb_t);
+        for (; first + lanes <= last; first += lanes)
+        {
+            __m256i carry = _mm256_setzero_si256();
+            for (int i = 0; i < size; ++i)
+            {
+                __m256i const lhs_digits = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(lhs + i * count + first));
+                __m256i const rhs_digits = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(rhs + i * count + first));
+                __m256i const sum = lanes_add(lhs_digits, rhs_digits);
+                __m256i const digits = lanes_sub(sum, carry);
+                carry = _mm256_or_si256(lanes_less(sum, lhs_digits), lanes_less(digits, sum));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + i * count + first), digits);
+            }
+            if (result_size > size)
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + size * count + first), lanes_sub(_mm256_setzero_si256(), carry));
+        }
+        batch_add_scalar(result, lhs, rhs, count, size, result_size, first, last);
+    }
+
+    __attribute__((target("avx2")))
+    static void batch_sub_avx2(limb_t * result, limb_t const * lhs, limb_t const * rhs, int count, int size, int result_size, int first, int last)
+    {
+        constexpr int lanes = sizeof(__m256i) / sizeof(limb_t);
+        for (; first + lanes <= last; first += lanes)
+        {
+            __m256i borrow = _mm256_setzero_si256();
+            for (int i = 0; i < size; ++i)
+            {
+                __m256i const lhs_digits = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(lhs + i * count + first));
+                __m256i const rhs_digits = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(rhs + i * count + first));
+                __m256i const difference = lanes_sub(lhs_digits, rhs_digits);
+                __m256i const digits = lanes_add(difference, borrow);
+                borrow = _mm256_or_si256(lanes_less(lhs_digits, rhs_digits), lanes_less(difference, digits));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + i * count + first), digits);
+            }
+            if (result_size > size)
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + size * count + first), lanes_sub(_mm256_setzero_si256(), borrow));
+        }
+        batch_sub_scalar(result, lhs, rhs, count, size, result_size, first, last);
+    }
+
+    // the 32-bit digits of 4 numbers widened to 64-bit lanes
+    __attribute__((target("avx2")))
+    static inline __m256i load_half_digits(limb_t const * digits, int count, int index)
+    {
+#if defined(BIGINT_LIMB_64)
+        __m256i const limbs = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(digits + (index / 2) * count));
+        return (index & 1) != 0 ? _mm256_srli_epi64(limbs, 32) : _mm256_and_si256(limbs, _mm256_set1_epi64x(0xffffffff));
+#else
+        return _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<__m128i const *>(digits + index * count)));
+#endif
+    }
+
+    // product scanning on 32-bit digits, the products are split into two column sums so that they cannot overflow
+    __attribute__((target("avx2")))
+    static void batch_mul_avx2(limb_t * result, limb_t const * lhs, limb_t const * rhs, int count, int size, int result_size, int first, int last)
+    {
+        constexpr int halves = sizeof(limb_t) / 4;
+        int const digits = size * halves;
+        int const result_digits = result_size * halves;
+        __m256i const low_mask = _mm256_set1_epi64x(0xffffffff);
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        __m256i * const lhs_digits = reinterpret_cast<__m256i *>(workspace.allocate(static_cast<int>(digits * 2 * sizeof(__m256i) / sizeof(limb_t)) + 1));
+        __m256i * const rhs_digits = lhs_digits + digits;
+        for (; first + 4 <= last; first += 4)
+        {
+            for (int i = 0; i < digits; ++i)
+            {
+                _mm256_storeu_si256(lhs_digits + i, load_half_digits(lhs + first, count, i));
+                _mm256_storeu_si256(rhs_digits + i, load_half_digits(rhs + first, count, i));
+            }
+            __m256i carry = _mm256_setzero_si256();
+#if defined(BIGINT_LIMB_64)
+            __m256i previous = _mm256_setzero_si256();
+#endif
+            for (int k = 0; k < result_digits; ++k)
+            {
+                __m256i low = carry;
+                __m256i high = _mm256_setzero_si256();
+                for (int i = std::max(k - digits + 1, 0); i <= std::min(k, digits - 1); ++i)
+                {
+                    __m256i const product = _mm256_mul_epu32(_mm256_loadu_si256(lhs_digits + i), _mm256_loadu_si256(rhs_digits + k - i));
+                    low = _mm256_add_epi64(low, _mm256_and_si256(product, low_mask));
+                    high = _mm256_add_epi64(high, _mm256_srli_epi64(product, 32));
+                }
+                __m256i const digit = _mm256_and_si256(low, low_mask);
+                carry = _mm256_add_epi64(_mm256_srli_epi64(low, 32), high);
+#if defined(BIGINT_LIMB_64)
+                if ((k & 1) == 0)
+                    previous = digit;
+                else
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + (k / 2) * count + first), _mm256_or_si256(previous, _mm256_slli_epi64(digit, 32)));
+#else
+                __m256i const packed = _mm256_permutevar8x32_epi32(digit, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(result + k * count + first), _mm256_castsi256_si128(packed));
+#endif
+            }
+        }
+        workspace.release(mark);
+        batch_mul_scalar(result, lhs, rhs, count, size, result_size, first, last);
+    }
+
+    __attribute__((target("avx2")))
+    static void batch_compare_avx2(int * results, limb_t const * lhs, limb_t const * rhs, int count, int size, int first, int last)
+    {
+        constexpr int lanes = sizeof(__m256i) / sizeof(limb_t);
+        for (; first + lanes <= last; first += lanes)
+        {
+            // from the high limbs down, each lane is decided by its first differing limb
+            __m256i undecided = _mm256_set1_epi8(-1);
+            __m256i signs = _mm256_setzero_si256();
+            for (int i = size - 1; i >= 0 && _mm256_movemask_epi8(undecided) != 0; --i)
+            {
+                __m256i const lhs_digits = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(lhs + i * count + first));
+                __m256i const rhs_digits = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(rhs + i * count + first));
+                __m256i const less = _mm256_and_si256(lanes_less(lhs_digits, rhs_digits), undecided);
+                __m256i const greater = _mm256_and_si256(lanes_less(rhs_digits, lhs_digits), undecided);
+                signs = lanes_add(signs, lanes_sub(less, greater));
+                undecided = _mm256_andnot_si256(_mm256_or_si256(less, greater), undecided);
+            }
+            limb_t values[lanes];
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(values), signs);
+            for (int j = 0; j < lanes; ++j)
+                results[first + j] = values[j] == 0 ? 0 : (values[j] == 1 ? 1 : -1);
+        }
+        batch_compare_scalar(results, lhs, rhs, count, size, first, last);
+    }
+#endif
+
+    struct batch_kernels
+    {
+        void (*add)(limb_t * result, limb_t const * lhs, limb_t const * rhs, int count, int size, int result_size, int first, int last);
+        void (*sub)(limb_t * result, limb_t const * lhs, limb_t const * rhs, int count, int size, int result_size, int first, int last);
+        void (*mul)(limb_t * result, limb_t const * lhs, limb_t const * rhs, int count, int size, int result_size, int first, int last);
+        void (*compare)(int * results, limb_t const * lhs, limb_t const * rhs, int count, int size, int first, int last);
+    };
+
+    static batch_kernels select_batch_kernels()
+    {
+#if defined(BIGINT_X86_SIMD)
+        if (__builtin_cpu_supports("avx2"))
+            return { batch_add_avx2, batch_sub_avx2, batch_mul_avx2, batch_compare_avx2 };
+#endif
+        return { batch_add_scalar, batch_sub_scalar, batch_mul_scalar, batch_compare_scalar };
+    }
+
+    static batch_kernels const & get_batch_kernels()
+    {
+        static batch_kernels const kernels = select_batch_kernels();
+        return kernels;
+    }
+
+    void set_allocator(void * (*alloc)(size_t), void (*dealloc)(void *))
+    {
+        g_allocate = alloc == nullptr ? ::malloc : alloc;
+        g_deallocate = dealloc == nullptr ? ::free : dealloc;
+    }
+
+    scratch::scratch()
+    {
+        m_first = nullptr;
+        m_top = nullptr;
+        m_position = 0;
+    }
+
+    scratch::~scratch()
+    {
+        while (m_first != nullptr)
+        {
+            chunk * const next = m_first->next;
+            m_first->deallocate(m_first);
+            m_first = next;
+        }
+    }
+
+    limb_t * scratch::allocate(int size)
+    {
+        if (m_top != nullptr && m_position + size <= m_top->base + m_top->capacity)
+        {
+            limb_t * const result = m_top->limbs() + (m_position - m_top->base);
+            m_position += size;
+            return result;
+        }
+
+        // the chunks above the top one are free, the next one is reused when it is big enough
+        chunk * next = m_top != nullptr ? m_top->next : m_first;
+        if (next == nullptr || next->capacity < static_cast<size_t>(size))
+        {
+            size_t const capacity = std::max(static_cast<size_t>(std::max(size, SCRATCH_CHUNK_SIZE)), m_top != nullptr ? m_top->capacity * 2 : 0);
+            while (next != nullptr)
+            {
+                chunk * const after = next->next;
+                next->deallocate(next);
+                next = after;
+            }
+            next = static_cast<chunk *>(g_allocate(sizeof(chunk) + sizeof(limb_t) * capacity));
+            next->previous = m_top;
+            next->next = nullptr;
+            next->base = m_top != nullptr ? m_top->base + m_top->capacity : 0;
+            next->capacity = capacity;
+            next->deallocate = g_deallocate;
+            if (m_top != nullptr)
+                m_top->next = next;
+            else
+                m_first = next;
+        }
+        m_top = next;
+        m_position = next->base + size;
+        return next->limbs();
+    }
+
+    size_t scratch::mark() const
+    {
+        return m_position;
+    }
+
+    void scratch::release(size_t mark)
+    {
+        assert(mark <= m_position);
+        while (m_top != nullptr && m_top->previous != nullptr && m_top->base >= mark)
+            m_top = m_top->previous;
+        m_position = mark;
+    }
+
+    void scratch::trim()
+    {
+        chunk * next = m_top != nullptr ? m_top->next : nullptr;
+        if (m_position == 0)
+        {
+            next = m_first;
+            m_first = nullptr;
+            m_top = nullptr;
+        }
+        else if (m_top != nullptr)
+        {
+            m_top->next = nullptr;
+        }
+        while (next != nullptr)
+        {
+            chunk * const after = next->next;
+            next->deallocate(next);
+            next = after;
+        }
+    }
+
+    void set_thread_count(int count)
+    {
+        g_task_pool.reset(count > 1 ? new task_pool(count) : nullptr);
+    }
+
+    void set_parallel_grain_size(int size)
+    {
+        g_parallel_grain_size = size <= 0 ? DEFAULT_PARALLEL_GRAIN_SIZE : size;
+    }
+
+    int from_base10(limb_t * digits, char const * str, int length)
+    {
+        return from_base10_recursive(digits, str, length, thread_scratch());
+    }
+
+    int from_base16(limb_t * digits, char const * str, int length)
+    {
+        while (length > 1 && *str == '0')
+        {
+            length--;
+            str++;
+        }
+
+        // full limbs come from the end of the string, the remaining head makes the most significant limb
+        int const head = length % LIMB_HEX_CHARACTERS;
+        int const count = length / LIMB_HEX_CHARACTERS;
+        if (!get_hex_kernels().parse(digits, str + head, count))
+            return -1;
+        if (head == 0)
+            return count;
+
+        limb_t invalid = 0;
+        limb_t digit = 0;
+        for (int i = 0; i < head; ++i)
+        {
+            limb_t const value = hex_value(str[i]);
+            invalid |= value;
+            digit = (digit << 4) | (value & 0xf);
+        }
+        if (invalid >= 16)
+            return -1;
+        digits[count] = digit;
+        return count + 1;
+    }
+
+    int to_base10(char * str, int capacity, limb_t const * digits, int size)
+    {
+        // every limb holds less than numerator_size + 1 decimal digits
+        int const bound = size * (largest_base10_numerator_fitting_in_limb_size() + 1);
+        scratch & workspace = thread_scratch();
+        if (capacity >= bound)
+            return to_base10_recursive(str, digits, size, workspace);
+
+        size_t const mark = workspace.mark();
+        char * const buffer = reinterpret_cast<char *>(workspace.allocate(bound / static_cast<int>(sizeof(limb_t)) + 1));
+        int const len = to_base10_recursive(buffer, digits, size, workspace);
+        for (int i = 0; i < std::min(capacity, len); ++i)
+            str[i] = buffer[i];
+        workspace.release(mark);
+        return len;
+    }
+
+    int to_base16(char * str, int capacity, limb_t const * digits, int size)
+    {
+        int shift = sizeof(limb_t) * 8;
+        while (((digits[size - 1] >> (shift - 4)) & 0xf) == 0 && shift > 4)
+        {
+            shift -= 4;
+        }
+        int const head = shift / 4;
+        int const len = head + (size - 1) * LIMB_HEX_CHARACTERS;
+        capacity = std::max(capacity, 0);
+
+        for (int i = 0; i < std::min(head, capacity); ++i)
+        {
+            shift -= 4;
+            str[i] = g_hex_characters[(digits[size - 1] >> shift) & 0xf];
+        }
+        if (capacity >= len)
+        {
+            get_hex_kernels().format(str + head, digits, size - 1);
+            return len;
+        }
+
+        // only the most significant characters fit, the last limb written being cut
+        int const remaining = capacity - head;
+        if (remaining > 0)
+        {
+            int const count = remaining / LIMB_HEX_CHARACTERS;
+            int const cut = remaining % LIMB_HEX_CHARACTERS;
+            get_hex_kernels().format(str + head, digits + size - 1 - count, count);
+            if (cut > 0)
+            {
+                char buffer[LIMB_HEX_CHARACTERS];
+                format_hex_limbs_scalar(buffer, digits + size - 2 - count, 1);
+                for (int i = 0; i < cut; ++i)
+                    str[head + count * LIMB_HEX_CHARACTERS + i] = buffer[i];
+            }
+        }
+        return len;
+    }
+
+    limb_divisor::limb_divisor(limb_t divisor)
+    {
+        assert(divisor != 0);
+        m_divisor = divisor;
+        m_shift = static_cast<int>(sizeof(limb_t) * 8 - de_bruijn(divisor) - 1);
+        m_normalized = divisor << m_shift;
+        m_reciprocal = static_cast<limb_t>(~static_cast<limb_double_t>(0) / m_normalized);
+    }
+
+    limb_t limb_divisor::divisor() const
+    {
+        return m_divisor;
+    }
+
+    // digits are shifted by the normalization shift on the fly, the remainder is shifted back at the end
+    int limb_divisor::divide(limb_t * quotient, limb_t const * digits, int size, limb_t * remainder) const
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        limb_t r = static_cast<limb_t>(static_cast<limb_double_t>(digits[size - 1]) >> (limb_bits - m_shift));
+        for (int i = size - 1; i > 0; --i)
+        {
+            limb_t const low = (digits[i] << m_shift) | static_cast<limb_t>(static_cast<limb_double_t>(digits[i - 1]) >> (limb_bits - m_shift));
+            quotient[i] = divide_by_reciprocal(&r, r, low, m_normalized, m_reciprocal);
+        }
+        quotient[0] = divide_by_reciprocal(&r, r, digits[0] << m_shift, m_normalized, m_reciprocal);
+        *remainder = r >> m_shift;
+        return trimmed_size(quotient, size);
+    }
+
+    limb_t limb_divisor::mod(limb_t const * digits, int size) const
+    {
+        constexpr limb_t limb_bits = sizeof(limb_t) * 8;
+        limb_t r = static_cast<limb_t>(static_cast<limb_double_t>(digits[size - 1]) >> (limb_bits - m_shift));
+        for (int i = size - 1; i > 0; --i)
+        {
+            limb_t const low = (digits[i] << m_shift) | static_cast<limb_t>(static_cast<limb_double_t>(digits[i - 1]) >> (limb_bits - m_shift));
+            divide_by_reciprocal(&r, r, low, m_normalized, m_reciprocal);
+        }
+        divide_by_reciprocal(&r, r, digits[0] << m_shift, m_normalized, m_reciprocal);
+        return r >> m_shift;
+    }
+
+    int compare(limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        if (lhs_size > rhs_size)
+            return 1;
+        if (lhs_size < rhs_size)
+            return -1;
+        for (int i = lhs_size - 1; i >= 0; --i)
+        {
+            if (lhs[i] > rhs[i])
+                return 1;
+            if (lhs[i] < rhs[i])
+                return -1;
+        }
+        return 0;
+    }
+
+    int add(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        if (lhs_size < rhs_size)
+        {
+            limb_t const * const tmp = lhs;
+            lhs = rhs;
+            rhs = tmp;
+            int const tmp_size = lhs_size;
+            lhs_size = rhs_size;
+            rhs_size = tmp_size;
+        }
+
+        int size = rhs_size;
+        limb_t carry = add_limbs(result, lhs, rhs, rhs_size);
+
+        while (size < lhs_size)
+        {
+            limb_t digit = lhs[size];
+            digit += carry;
+            carry = (digit < carry) ? 1 : 0;
+            result[size] = digit;
+            ++size;
+        }
+        if (carry > 0)
+            result[size] = carry;
+        size += carry;
+        return size;
+    }
+
+    int sub(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        assert(lhs_size >= rhs_size);
+        int size = rhs_size;
+        limb_t carry = sub_limbs(result, lhs, rhs, rhs_size);
+
+        while (size < lhs_size)
+        {
+            limb_t digit = lhs[size];
+            digit -= carry;
+            carry = (digit > lhs[size]) ? 1 : 0;
+            result[size] = digit;
+            ++size;
+        }
+        assert(carry == 0);
+        while (size > 1 && result[size - 1] == 0)
+        {
+            --size;
+        }
+        return size;
+    }
+
+    int shl(limb_t * result, limb_t const * digits, int size, int bits)
+    {
+        constexpr int limb_bits = sizeof(limb_t) * 8;
+        int const limbs = bits / limb_bits;
+        if (size == 1 && *digits == 0)
+        {
+            *result = 0;
+            return 1;
+        }
+
+        // from the top down, so that result can be digits
+        limb_t const high = shift_left(result + limbs, digits, size, bits % limb_bits);
+        result[limbs + size] = high;
+        for (int i = 0; i < limbs; ++i)
+            result[i] = 0;
+        return limbs + size + (high != 0 ? 1 : 0);
+    }
+
+    int shr(limb_t * result, limb_t const * digits, int size, int bits)
+    {
+        constexpr int limb_bits = sizeof(limb_t) * 8;
+        int const limbs = bits / limb_bits;
+        if (limbs >= size)
+        {
+            *result = 0;
+            return 1;
+        }
+        return shift_right(result, digits + limbs, size - limbs, bits % limb_bits);
+    }
+
+    int bit_and(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        int const size = std::min(lhs_size, rhs_size);
+        for (int i = 0; i < size; ++i)
+            result[i] = lhs[i] & rhs[i];
+        return trimmed_size(result, size);
+    }
+
+    int bit_or(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        if (lhs_size < rhs_size)
+        {
+            std::swap(lhs, rhs);
+            std::swap(lhs_size, rhs_size);
+        }
+        for (int i = 0; i < rhs_size; ++i)
+            result[i] = lhs[i] | rhs[i];
+        for (int i = rhs_size; i < lhs_size; ++i)
+            result[i] = lhs[i];
+        return lhs_size;
+    }
+
+    int bit_xor(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        if (lhs_size < rhs_size)
+        {
+            std::swap(lhs, rhs);
+            std::swap(lhs_size, rhs_size);
+        }
+        for (int i = 0; i < rhs_size; ++i)
+            result[i] = lhs[i] ^ rhs[i];
+        for (int i = rhs_size; i < lhs_size; ++i)
+            result[i] = lhs[i];
+        return trimmed_size(result, lhs_size);
+    }
+
+    int bit_length(limb_t const * digits, int size)
+    {
+        if (size == 1 && *digits == 0)
+            return 0;
+        return (size - 1) * static_cast<int>(sizeof(limb_t) * 8) + static_cast<int>(de_bruijn(digits[size - 1])) + 1;
+    }
+
+    int mul(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        return mul_with_scratch(result, lhs, rhs, lhs_size, rhs_size, thread_scratch());
+    }
+
+    int mul_with_scratch(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, scratch & workspace)
+    {
+        if (lhs == rhs && lhs_size == rhs_size && lhs_size > KARATSUBA_SQUARING_THRESHOLD)
+        {
+            size_t const mark = workspace.mark();
+            limb_t * const memory = workspace.allocate(mul_scratch_size(lhs_size, lhs_size));
+            int const result_size = sqr_with_scratch_memory(result, lhs, lhs_size, memory);
+            workspace.release(mark);
+            return result_size;
+        }
+        if (lhs == rhs && lhs_size == rhs_size)
+        {
+            return sqr_with_scratch_memory(result, lhs, lhs_size, nullptr);
+        }
+        if (lhs_size > KARATSUBA_THRESHOLD && rhs_size > KARATSUBA_THRESHOLD)
+        {
+            size_t const mark = workspace.mark();
+            limb_t * const memory = workspace.allocate(mul_scratch_size(lhs_size, rhs_size));
+            int const result_size = mul_with_scratch_memory(result, lhs, rhs, lhs_size, rhs_size, memory);
+            workspace.release(mark);
+            return result_size;
+        }
+        else
+        {
+            return mul_with_scratch_memory(result, lhs, rhs, lhs_size, rhs_size, nullptr);
+        }
+    }
+
+    int sqr(limb_t * result, limb_t const * digits, int size)
+    {
+        return mul_with_scratch(result, digits, digits, size, size, thread_scratch());
+    }
+
+    int div(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        return div_with_scratch(result, lhs, rhs, lhs_size, rhs_size, thread_scratch());
+    }
+
+    int div_with_scratch(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, scratch & workspace)
+    {
+        assert(!(rhs_size == 1 && *rhs == 0));
+
+        if (lhs_size < rhs_size)
+        {
+            *result = 0;
+            return 1;
+        }
+
+        if (rhs_size > 1)
+        {
+            return divide_multi_limb<false, true>(result, lhs, rhs, lhs_size, rhs_size, nullptr, nullptr, workspace);
+        }
+        else
+        {
+            limb_t remainder_digit;
+            return divide_by_one_digit(result, lhs, rhs[0], lhs_size, &remainder_digit);
+        }
+    }
+
+    int mod(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        return mod_with_scratch(result, lhs, rhs, lhs_size, rhs_size, thread_scratch());
+    }
+
+    int mod_with_scratch(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, scratch & workspace)
+    {
+        assert(!(rhs_size == 1 && *rhs == 0));
+
+        if (lhs_size < rhs_size)
+        {
+            for (int i = 0; i < lhs_size; ++i)
+                result[i] = lhs[i];
+            return lhs_size;
+        }
+
+        if (rhs_size > 1)
+        {
+            int result_size;
+            divide_multi_limb<true, false>(nullptr, lhs, rhs, lhs_size, rhs_size, result, &result_size, workspace);
+            return result_size;
+        }
+        else
+        {
+            *result = mod_by_one_digit(lhs, rhs[0], lhs_size);
+            return 1;
+        }
+    }
+
+    int divmod(limb_t * quotient, limb_t * remainder, int * remainder_size, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        assert(!(rhs_size == 1 && *rhs == 0));
+
+        if (lhs_size < rhs_size)
+        {
+            for (int i = 0; i < lhs_size; ++i)
+                remainder[i] = lhs[i];
+            *remainder_size = lhs_size;
+            *quotient = 0;
+            return 1;
+        }
+        return divide(quotient, remainder, remainder_size, lhs, rhs, lhs_size, rhs_size, thread_scratch());
+    }
+
+    int inverse(limb_t * result, limb_t const * digits, int size)
+    {
+        assert(!(size == 1 && *digits == 0));
+
+        int const memory_size = size + (size + 1) + (size * 2 + 2) + (size + 3) + size + mul_scratch_size(size + 2, size + 2);
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        limb_t * const normalized = workspace.allocate(memory_size);
+        limb_t * const normalized_reciprocal = normalized + size;
+        limb_t * const product = normalized_reciprocal + size + 1;
+        limb_t * const quotient = product + size * 2 + 2;
+        limb_t * const remainder = quotient + size + 3;
+        limb_t * const memory = remainder + size;
+
+        // the reciprocal of digits * 2^shift shifted back is within a few units times 2^shift of the result
+        int const shift = static_cast<int>(sizeof(limb_t) * 8 - de_bruijn(digits[size - 1]) - 1);
+        shift_left(normalized, digits, size, shift);
+        reciprocal(normalized_reciprocal, normalized, size, workspace);
+        result[size + 1] = shift_left(result, normalized_reciprocal, size + 1, shift);
+
+        // the remaining error is (base^(size * 2) - digits * result) / digits, rounded toward the result
+        mul_padded(product, digits, result, size, size + 2, memory);
+        bool const above = product[size * 2 + 1] != 0 || product[size * 2] > 1 || (product[size * 2] == 1 && (trimmed_size(product, size * 2) > 1 || product[0] != 0));
+        if (above)
+        {
+            decrement(product + size * 2, 2);
+            decrement(product, size * 2 + 2);
+        }
+        else if (product[size * 2] == 1)
+        {
+            product[size * 2] = 0;
+        }
+        else
+        {
+            for (int i = 0; i < size * 2; ++i)
+                product[i] = ~product[i];
+            increment(product, size * 2);
+        }
+        int const product_size = trimmed_size(product, size * 2 + 2);
+        if (product_size >= size)
+        {
+            int remainder_size;
+            int const quotient_size = divide(quotient, remainder, &remainder_size, product, digits, product_size, size, workspace);
+            for (int i = quotient_size; i < size + 2; ++i)
+                quotient[i] = 0;
+            if (above)
+            {
+                sub_in_place(result, quotient, size + 2);
+                decrement(result, size + 2);
+            }
+            else
+            {
+                add_in_place(result, quotient, size + 2);
+            }
+        }
+        else if (above)
+        {
+            decrement(result, size + 2);
+        }
+        workspace.release(mark);
+        return trimmed_size(result, size + 2);
+    }
+
+    int gcd(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        return extended_gcd(result, nullptr, nullptr, nullptr, lhs, rhs, lhs_size, rhs_size, thread_scratch());
+    }
+
+    int xgcd(limb_t * result, limb_t * cofactor, int * cofactor_size, bool * cofactor_negative, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    {
+        return extended_gcd(result, cofactor, cofactor_size, cofactor_negative, lhs, rhs, lhs_size, rhs_size, thread_scratch());
+    }
+
+    int modinv(limb_t * result, limb_t const * digits, limb_t const * modulus, int size, int modulus_size)
+    {
+        assert(!(modulus_size == 1 && *modulus == 0));
+
+        if (modulus_size == 1 && *modulus == 1)
+        {
+            *result = 0;
+            return 1;
+        }
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        limb_t * const reduced = workspace.allocate(modulus_size);
+        limb_t * const divisor = workspace.allocate(modulus_size);
+        limb_t * const cofactor = workspace.allocate(modulus_size + 2);
+        if (compare(digits, modulus, size, modulus_size) >= 0)
+        {
+            size = mod_with_scratch(reduced, digits, modulus, size, modulus_size, workspace);
+            digits = reduced;
         }
-
-        while (length > 0)
+        int cofactor_size;
+        bool cofactor_negative;
+        int const divisor_size = extended_gcd(divisor, cofactor, &cofactor_size, &cofactor_negative, digits, modulus, size, modulus_size, workspace);
+        int result_size = -1;
+        if (divisor_size == 1 && *divisor == 1)
         {
-            if ((bitshift % (sizeof(limb_t) * 8)) == 0)
-            {
-                bitshift = 0;
-                index++;
-                digits[index] = 0;
-            }
-            --length;
-            if (str[length] >= 'a' && str[length] <= 'f')
+            // the cofactor is below the modulus, a negative one is taken back into [0, modulus)
+            if (cofactor_negative)
             {
-                digits[index] |= ((str[length] - 'a' + 10) << bitshift);
+                result_size = sub(result, modulus, cofactor, modulus_size, cofactor_size);
             }
-            else if (str[length] >= 'A' && str[length] <= 'F')
-            {
-                digits[index] |= ((str[length] - 'A' + 10) << bitshift);
-            }
-            else if (str[length] >= '0' && str[length] <= '9')
+            else
             {
-                digits[index] |= ((str[length] - '0') << bitshift);
+                std::copy(cofactor, cofactor + cofactor_size, result);
+                result_size = cofactor_size;
             }
-            else
-                return -1;
-            bitshift += 4;
         }
-        return index + 1;
+        workspace.release(mark);
+        return result_size;
     }
 
-    int to_base10(char * str, int capacity, limb_t const * digits, int size)
+    int isqrt(limb_t * result, limb_t * remainder, int * remainder_size, limb_t const * digits, int size)
     {
-        constexpr limb_t numerator = largest_base10_numerator_fitting_in_limb();
-        constexpr int numerator_size = largest_base10_numerator_fitting_in_limb_size();
-        limb_t * const copy = static_cast<limb_t *>(g_allocate(sizeof(limb_t) * size));
-        int len = 0;
+        return iroot(result, remainder, remainder_size, digits, size, 2);
+    }
 
-        for (int i = 0; i < size; ++i)
-            copy[i] = digits[i];
-        while (size > 1 || *copy >= numerator)
+    int iroot(limb_t * result, limb_t * remainder, int * remainder_size, limb_t const * digits, int size, int k)
+    {
+        assert(k > 0);
+
+        int const bits = bit_length(digits, size);
+        if (k == 1 || bits == 0)
         {
-            limb_t remainder;
-            size = divide_by_one_digit(copy, copy, numerator, size, &remainder);
-            for (int i = 0; i < numerator_size; ++i)
+            // digits is its own first root, zero its own root
+            std::copy(digits, digits + size, result);
+            if (remainder != nullptr)
             {
-                if (len < capacity)
-                    str[len] = (remainder % 10) + '0';
-                ++len;
-                remainder /= 10;
+                *remainder = 0;
+                *remainder_size = 1;
             }
+            return size;
         }
-        while (*copy > 0)
-        {
-            if (len < capacity)
-                str[len] = (*copy % 10) + '0';
-            ++len;
-            *copy /= 10;
-        }
-        g_deallocate(copy);
-        
-        int i = 0;
-        int j = std::min(capacity, len - 1);
-        while (i < j)
+        if (k >= bits)
         {
-            char const tmp = str[i];
-            str[i++] = str[j];
-            str[j--] = tmp;
+            // digits is below 2^k, its root is one
+            *result = 1;
+            if (remainder != nullptr)
+                *remainder_size = sub(remainder, digits, result, size, 1);
+            return 1;
         }
-        return len;
+
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        int const capacity = size / k + 3;
+        limb_t * const root = workspace.allocate(capacity);
+        limb_t * const power_digits = workspace.allocate(capacity * (k - 1));
+        limb_t * const product = workspace.allocate(capacity * k);
+        int root_size = root_estimate(root, digits, size, k, workspace);
+
+        // the estimate is at most a step above the root rounded down
+        int product_size;
+        root_size = root_descend(root, root_size, power_digits, product, &product_size, digits, size, k, workspace);
+        std::copy(root, root + root_size, result);
+        if (remainder != nullptr)
+            *remainder_size = sub(remainder, digits, product, size, product_size);
+        workspace.release(mark);
+        return root_size;
     }
 
-    int to_base16(char * str, int capacity, limb_t const * digits, int size)
+    montgomery::montgomery(limb_t const * modulus, int size)
     {
-        int len = 0;
-        limb_t shift = sizeof(limb_t) * 8;
-        
-        while (((digits[size - 1] >> (shift - 4)) & 0xf) == 0 && shift > 4)
-        {
-            shift -= 4;
-        }
-        for (int i = size - 1; i >= 0; --i)
-        {
-            while (shift > 0)
-            {
-                shift -= 4;
-                if (len < capacity)
-                {
-                    limb_t const hexdigit = (digits[i] >> shift) & 0xf;
-                    if (hexdigit >= 0 && hexdigit < 10)
-                        str[len] = '0' + static_cast<char>(hexdigit);
-                    else
-                        str[len] = 'a' + static_cast<char>(hexdigit - 10);
-                }
-                ++len;
-            }
-            shift = sizeof(limb_t) * 8;
-        }
-        return len;
+        assert(size > 1 || *modulus > 1);
+        assert((*modulus & 1) != 0);
+
+        m_size = size;
+        m_modulus = static_cast<limb_t *>(g_allocate(sizeof(limb_t) * (size * 2 + (size * 2 + 2))));
+        m_r2 = m_modulus + size;
+        m_work = m_r2 + size;
+        for (int i = 0; i < size; ++i)
+            m_modulus[i] = modulus[i];
+
+        // newton iteration doubling the correct low bits of 1 / modulus, starting from the 3 bits of modulus itself
+        limb_t inverse = *modulus;
+        for (int i = 3; i < static_cast<int>(sizeof(limb_t) * 8); i *= 2)
+            inverse *= 2 - *modulus * inverse;
+        m_inverse = 0 - inverse;
+
+        // base^(size * 2) mod modulus
+        for (int i = 0; i < size * 2; ++i)
+            m_work[i] = 0;
+        m_work[size * 2] = 1;
+        int const r2_size = bigint::mod(m_r2, m_work, m_modulus, size * 2 + 1, size);
+        for (int i = r2_size; i < size; ++i)
+            m_r2[i] = 0;
     }
 
-    int compare(limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    montgomery::~montgomery()
     {
-        if (lhs_size > rhs_size)
-            return 1;
-        if (lhs_size < rhs_size)
-            return -1;
-        for (int i = lhs_size - 1; i >= 0; --i)
-        {
-            if (lhs[i] > rhs[i])
-                return 1;
-            if (lhs[i] < rhs[i])
-                return -1;
-        }
-        return 0;
+        g_deallocate(m_modulus);
     }
 
-    int add(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    int montgomery::size() const
     {
-        if (lhs_size < rhs_size)
-        {
-            limb_t const * const tmp = lhs;
-            lhs = rhs;
-            rhs = tmp;
-            int const tmp_size = lhs_size;
-            lhs_size = rhs_size;
-            rhs_size = tmp_size;
-        }
-
-        int size = 0;
-        limb_t carry = 0;
+        return m_size;
+    }
 
-        while (size < rhs_size)
+    void montgomery::to_montgomery(limb_t * result, limb_t const * digits, int size)
+    {
+        size = trimmed_size(digits, size);
+        if (compare(digits, m_modulus, size, trimmed_size(m_modulus, m_size)) >= 0)
         {
-            limb_t digit = lhs[size];
-            digit += carry;
-            carry = (digit < carry) ? 1 : 0;
-            digit += rhs[size];
-            carry = (digit < rhs[size]) ? 1 : carry;
-            result[size] = digit;
-            ++size;
+            size = bigint::mod(result, digits, m_modulus, size, trimmed_size(m_modulus, m_size));
         }
-        while (size < lhs_size)
+        else
         {
-            limb_t digit = lhs[size];
-            digit += carry;
-            carry = (digit < carry) ? 1 : 0;
-            result[size] = digit;
-            ++size;
+            for (int i = 0; i < size; ++i)
+                result[i] = digits[i];
         }
-        if (carry > 0)
-            result[size] = carry;
-        size += carry;
-        return size;
+        for (int i = size; i < m_size; ++i)
+            result[i] = 0;
+        montgomery_multiply(result, result, m_r2, m_modulus, m_inverse, m_size, m_work);
     }
 
-    int sub(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    int montgomery::from_montgomery(limb_t * result, limb_t const * digits)
     {
-        assert(lhs_size >= rhs_size);
-        int size = 0;
-        limb_t carry = 0;
+        montgomery_reduce(result, digits, m_modulus, m_inverse, m_size, m_work);
+        return trimmed_size(result, m_size);
+    }
 
-        while (size < rhs_size)
-        {
-            limb_t digit = lhs[size];
-            digit -= carry;
-            carry = (digit > lhs[size]) ? 1 : 0;
-            limb_t const prev = digit;
-            digit -= rhs[size];
-            carry = (digit > prev) ? 1 : carry;
-            result[size] = digit;
-            ++size;
-        }
-        while (size < lhs_size)
+    void montgomery::mul(limb_t * result, limb_t const * lhs, limb_t const * rhs)
+    {
+        montgomery_multiply(result, lhs, rhs, m_modulus, m_inverse, m_size, m_work);
+    }
+
+    int montgomery::pow(limb_t * result, limb_t const * base, limb_t const * exponent, int base_size, int exponent_size)
+    {
+        exponent_size = trimmed_size(exponent, exponent_size);
+        if (exponent_size == 1 && *exponent == 0)
         {
-            limb_t digit = lhs[size];
-            digit -= carry;
-            carry = (digit > lhs[size]) ? 1 : 0;
-            result[size] = digit;
-            ++size;
+            // one, unless the modulus is one
+            *result = m_size > 1 || *m_modulus > 1 ? 1 : 0;
+            for (int i = 1; i < m_size; ++i)
+                result[i] = 0;
+            return 1;
         }
-        assert(carry == 0);
-        while (size > 1 && result[size - 1] == 0)
+
+        int const window = power_window(exponent_size * static_cast<int>(sizeof(limb_t) * 8));
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        limb_t * const converted = workspace.allocate(m_size);
+        limb_t * const table = workspace.allocate(m_size << (window - 1));
+        to_montgomery(converted, base, base_size);
+        sliding_window_power(result, converted, exponent, exponent_size, m_size, window, table, [this](limb_t * r, limb_t const * lhs, limb_t const * rhs)
         {
-            --size;
-        }
-        return size;
+            montgomery_multiply(r, lhs, rhs, m_modulus, m_inverse, m_size, m_work);
+        });
+        int const result_size = from_montgomery(result, result);
+        workspace.release(mark);
+        return result_size;
     }
 
-    int mul(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    reducer::reducer(limb_t const * modulus, int size)
+        : m_divisor(size == 1 ? *modulus : 1)
     {
-        if (lhs_size > KARATSUBA_THRESHOLD && rhs_size > KARATSUBA_THRESHOLD)
-        {
-            int const capacity = (lhs_size + rhs_size) * 2;
-            limb_t * const memory = static_cast<limb_t *>(g_allocate(sizeof(limb_t) * capacity));
-            int const result_size = mul_with_scratch_memory(result, lhs, rhs, lhs_size, rhs_size, memory);
-            g_deallocate(memory);
-            return result_size;
-        }
-        else
+        init(modulus, size);
+    }
+
+    reducer::reducer(number const & modulus)
+        : m_divisor(modulus.m_size == 1 ? *modulus.m_digits : 1)
+    {
+        init(modulus.m_digits, modulus.m_size);
+    }
+
+    void reducer::init(limb_t const * modulus, int size)
+    {
+        assert(!(size == 1 && *modulus == 0));
+
+        // inputs of up to size * 2 limbs are normalized and divided in the preallocated memory, the reciprocal, the
+        // product, the quotient and the multiplication scratch are only used by the barrett reduction of big moduli
+        bool const barrett = size >= BARRETT_REDUCTION_THRESHOLD;
+        int memory_size = size + size + (size * 2 + 1);
+        if (barrett)
+            memory_size += (size + 1) + (size * 2 + 1) + (size + 1) + mul_scratch_size(size + 1, size + 1);
+        m_size = size;
+        m_modulus = static_cast<limb_t *>(g_allocate(sizeof(limb_t) * memory_size));
+        m_normalized = m_modulus + size;
+        m_lhs = m_normalized + size;
+        m_reciprocal = nullptr;
+        m_product = nullptr;
+        m_quotient = nullptr;
+        m_memory = nullptr;
+        if (barrett)
         {
-            return mul_with_scratch_memory(result, lhs, rhs, lhs_size, rhs_size, nullptr);
+            m_reciprocal = m_lhs + size * 2 + 1;
+            m_product = m_reciprocal + size + 1;
+            m_quotient = m_product + size * 2 + 1;
+            m_memory = m_quotient + size + 1;
         }
+        for (int i = 0; i < size; ++i)
+            m_modulus[i] = modulus[i];
+        m_shift = static_cast<int>(sizeof(limb_t) * 8 - de_bruijn(modulus[size - 1]) - 1);
+        shift_left(m_normalized, modulus, size, m_shift);
+        if (barrett)
+            reciprocal(m_reciprocal, m_normalized, size, thread_scratch());
     }
 
-    int div(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    reducer::~reducer()
     {
-        assert(!(rhs_size == 1 && *rhs == 0));
+        g_deallocate(m_modulus);
+    }
 
-        if (lhs_size < rhs_size)
+    int reducer::size() const
+    {
+        return m_size;
+    }
+
+    int reducer::reduce(limb_t * result, limb_t const * digits, int size)
+    {
+        if (compare(digits, m_modulus, size, m_size) < 0)
         {
-            *result = 0;
+            for (int i = 0; i < size; ++i)
+                result[i] = digits[i];
+            return size;
+        }
+        if (m_size == 1)
+        {
+            *result = m_divisor.mod(digits, size);
             return 1;
         }
 
-        if (rhs_size > 1)
+        // bigger inputs take their normalized copy and quotient from the thread scratch
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        bool const preallocated = size <= m_size * 2;
+        limb_t * const lhs = preallocated ? m_lhs : workspace.allocate(size + 1);
+        lhs[size] = shift_left(lhs, digits, size, m_shift);
+        if (m_size < BARRETT_REDUCTION_THRESHOLD)
         {
-            return algorithm_d<false, true>(result, lhs, rhs, lhs_size, rhs_size, nullptr, nullptr);
+            divide_normalized<true>(nullptr, lhs, m_normalized, size + 1, m_size);
         }
         else
         {
-            limb_t remainder_digit;
-            return divide_by_one_digit(result, lhs, rhs[0], lhs_size, &remainder_digit);
+            limb_t * const quotient = preallocated ? m_quotient : workspace.allocate(size - m_size + 1);
+            divide_blocks(quotient, lhs, m_normalized, m_reciprocal, size - m_size + 1, m_size, m_product, m_memory);
         }
+        int const result_size = shift_right(result, lhs, m_size, m_shift);
+        workspace.release(mark);
+        return result_size;
     }
 
-    int mod(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size)
+    void reducer::reduce(number & result, number const & value)
     {
-        assert(!(rhs_size == 1 && *rhs == 0));
-
-        if (lhs_size < rhs_size)
+        if (result.m_capacity < m_size)
         {
-            for (int i = 0; i < lhs_size; ++i)
-                result[i] = lhs[i];
-            return lhs_size;
+            number reduced;
+            reduced.allocate(m_size);
+            reduced.m_size = reduce(reduced.m_digits, value.m_digits, value.m_size);
+            reduced.m_negative = value.m_negative;
+            result = std::move(reduced);
+            return;
         }
+        // result can be value, the digits are read before the remainder is written
+        bool const negative = value.m_negative;
+        result.m_size = reduce(result.m_digits, value.m_digits, value.m_size);
+        result.m_negative = negative;
+    }
 
-        if (rhs_size > 1)
+    batch::batch(int count, int size)
+    {
+        assert(count > 0 && size > 0);
+        m_count = count;
+        m_size = size;
+        m_digits = static_cast<limb_t *>(g_allocate(sizeof(limb_t) * count * size));
+        std::fill(m_digits, m_digits + count * size, 0);
+    }
+
+    batch::~batch()
+    {
+        g_deallocate(m_digits);
+    }
+
+    int batch::count() const
+    {
+        return m_count;
+    }
+
+    int batch::size() const
+    {
+        return m_size;
+    }
+
+    limb_t * batch::digits()
+    {
+        return m_digits;
+    }
+
+    limb_t const * batch::digits() const
+    {
+        return m_digits;
+    }
+
+    void batch::set(int index, limb_t const * digits, int size)
+    {
+        assert(index >= 0 && index < m_count && size <= m_size);
+        for (int i = 0; i < m_size; ++i)
+            m_digits[i * m_count + index] = i < size ? digits[i] : 0;
+    }
+
+    void batch::get(int index, limb_t * digits) const
+    {
+        assert(index >= 0 && index < m_count);
+        for (int i = 0; i < m_size; ++i)
+            digits[i] = m_digits[i * m_count + index];
+    }
+
+    void add(batch & result, batch const & lhs, batch const & rhs)
+    {
+        assert(lhs.count() == rhs.count() && lhs.size() == rhs.size() && result.count() == lhs.count());
+        assert(result.size() == lhs.size() || result.size() == lhs.size() + 1);
+        get_batch_kernels().add(result.digits(), lhs.digits(), rhs.digits(), lhs.count(), lhs.size(), result.size(), 0, lhs.count());
+    }
+
+    void sub(batch & result, batch const & lhs, batch const & rhs)
+    {
+        assert(lhs.count() == rhs.count() && lhs.size() == rhs.size() && result.count() == lhs.count());
+        assert(result.size() == lhs.size() || result.size() == lhs.size() + 1);
+        get_batch_kernels().sub(result.digits(), lhs.digits(), rhs.digits(), lhs.count(), lhs.size(), result.size(), 0, lhs.count());
+    }
+
+    void mul(batch & result, batch const & lhs, batch const & rhs)
+    {
+        assert(lhs.count() == rhs.count() && lhs.size() == rhs.size() && result.count() == lhs.count());
+        assert(result.size() <= lhs.size() * 2);
+        get_batch_kernels().mul(result.digits(), lhs.digits(), rhs.digits(), lhs.count(), lhs.size(), result.size(), 0, lhs.count());
+    }
+
+    void compare(int * results, batch const & lhs, batch const & rhs)
+    {
+        assert(lhs.count() == rhs.count() && lhs.size() == rhs.size());
+        get_batch_kernels().compare(results, lhs.digits(), rhs.digits(), lhs.count(), lhs.size(), 0, lhs.count());
+    }
+
+    int powmod(limb_t * result, limb_t const * base, limb_t const * exponent, limb_t const * modulus, int base_size, int exponent_size, int modulus_size)
+    {
+        assert(!(modulus_size == 1 && *modulus == 0));
+
+        if (modulus_size == 1 && *modulus == 1)
         {
-            int result_size;
-            algorithm_d<true, false>(nullptr, lhs, rhs, lhs_size, rhs_size, result, &result_size);
-            return result_size;
+            *result = 0;
+            return 1;
         }
-        else
+        if ((*modulus & 1) != 0)
         {
-            *result = mod_by_one_digit(lhs, rhs[0], lhs_size);
+            montgomery context(modulus, modulus_size);
+            return context.pow(result, base, exponent, base_size, exponent_size);
+        }
+
+        // even modulus, every step is reduced by a barrett reduction
+        exponent_size = trimmed_size(exponent, exponent_size);
+        if (exponent_size == 1 && *exponent == 0)
+        {
+            *result = 1;
             return 1;
         }
+        int const window = power_window(exponent_size * static_cast<int>(sizeof(limb_t) * 8));
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        limb_t * const reduced = workspace.allocate(modulus_size);
+        limb_t * const product = workspace.allocate(modulus_size * 2);
+        limb_t * const table = workspace.allocate(modulus_size << (window - 1));
+        reducer context(modulus, modulus_size);
+        int const reduced_size = context.reduce(reduced, base, base_size);
+        for (int i = reduced_size; i < modulus_size; ++i)
+            reduced[i] = 0;
+        sliding_window_power(result, reduced, exponent, exponent_size, modulus_size, window, table, [&](limb_t * r, limb_t const * lhs, limb_t const * rhs)
+        {
+            int const product_size = mul_with_scratch(product, lhs, rhs, trimmed_size(lhs, modulus_size), trimmed_size(rhs, modulus_size), workspace);
+            int const size = context.reduce(r, product, product_size);
+            for (int i = size; i < modulus_size; ++i)
+                r[i] = 0;
+        });
+        workspace.release(mark);
+        return trimmed_size(result, modulus_size);
     }
 
     number::number()
     {
         m_size = 1;
-        m_capacity = 0;
+        m_capacity = INLINE_CAPACITY;
         m_negative = false;
-        m_digits = &g_zero;
+        m_digits = m_inline;
+        m_inline[0] = 0;
     }
 
     number::number(number const & other)
     {
+        allocate(other.m_size);
         m_size = other.m_size;
-        m_capacity = other.m_size;
         m_negative = other.m_negative;
-        m_digits = static_cast<limb_t *>(g_allocate(m_capacity * sizeof(limb_t)));
         for (int i = 0; i < m_size; ++i)
             m_digits[i] = other.m_digits[i];
     }
@@ -609,28 +4242,30 @@ namespace bigint
     number::number(number && other)
     {
         m_size = other.m_size;
-        m_capacity = other.m_capacity;
         m_negative = other.m_negative;
-        m_digits = other.m_digits;
+        if (other.m_digits == other.m_inline)
+        {
+            m_capacity = INLINE_CAPACITY;
+            m_digits = m_inline;
+            for (int i = 0; i < m_size; ++i)
+                m_inline[i] = other.m_inline[i];
+        }
+        else
+        {
+            m_capacity = other.m_capacity;
+            m_digits = other.m_digits;
+        }
         other.m_size = 1;
-        other.m_capacity = 0;
+        other.m_capacity = INLINE_CAPACITY;
         other.m_negative = false;
-        other.m_digits = &g_zero;
+        other.m_digits = other.m_inline;
+        other.m_inline[0] = 0;
     }
 
     number & number::operator=(number const & other)
     {
         if (this != &other)
-        {
-            if (m_digits != &g_zero)
-                g_deallocate(m_digits);
-            m_size = other.m_size;
-            m_capacity = other.m_size;
-            m_negative = other.m_negative;
-            m_digits = static_cast<limb_t *>(g_allocate(m_capacity * sizeof(limb_t)));
-            for (int i = 0; i < m_size; ++i)
-                m_digits[i] = other.m_digits[i];
-        }
+            assign(other.m_digits, other.m_size, other.m_negative);
         return *this;
     }
 
@@ -638,37 +4273,134 @@ namespace bigint
     {
         if (this != &other)
         {
-            if (m_digits != &g_zero)
-                g_deallocate(m_digits);
+            deallocate();
             m_size = other.m_size;
-            m_capacity = other.m_capacity;
             m_negative = other.m_negative;
-            m_digits = other.m_digits;
+            if (other.m_digits == other.m_inline)
+            {
+                for (int i = 0; i < m_size; ++i)
+                    m_inline[i] = other.m_inline[i];
+            }
+            else
+            {
+                m_capacity = other.m_capacity;
+                m_digits = other.m_digits;
+            }
             other.m_size = 1;
-            other.m_capacity = 0;
+            other.m_capacity = INLINE_CAPACITY;
             other.m_negative = false;
-            other.m_digits = &g_zero;
+            other.m_digits = other.m_inline;
+            other.m_inline[0] = 0;
+        }
+        return *this;
+    }
+
+    number::~number()
+    {
+        deallocate();
+    }
+
+    // the number must not own heap digits, leaves the size and sign untouched
+    void number::allocate(int capacity)
+    {
+        if (capacity <= INLINE_CAPACITY)
+        {
+            m_capacity = INLINE_CAPACITY;
+            m_digits = m_inline;
+        }
+        else
+        {
+            m_capacity = capacity;
+            m_digits = static_cast<limb_t *>(g_allocate(m_capacity * sizeof(limb_t)));
+        }
+    }
+
+    void number::deallocate()
+    {
+        if (m_digits != m_inline)
+            g_deallocate(m_digits);
+        m_capacity = INLINE_CAPACITY;
+        m_digits = m_inline;
+    }
+
+    // digits must not point into this number
+    void number::assign(limb_t const * digits, int size, bool negative)
+    {
+        if (m_capacity < size)
+        {
+            int const capacity = std::max(size, m_capacity * 2);
+            deallocate();
+            allocate(capacity);
         }
-        return *this;
+        m_size = size;
+        m_negative = negative;
+        for (int i = 0; i < size; ++i)
+            m_digits[i] = digits[i];
     }
 
-    number::~number()
+    void number::reserve(int capacity)
     {
-        if (m_digits != &g_zero)
+        if (capacity <= m_capacity)
+            return;
+        limb_t * const digits = static_cast<limb_t *>(g_allocate(std::max(capacity, m_capacity * 2) * sizeof(limb_t)));
+        for (int i = 0; i < m_size; ++i)
+            digits[i] = m_digits[i];
+        if (m_digits != m_inline)
             g_deallocate(m_digits);
+        m_capacity = std::max(capacity, m_capacity * 2);
+        m_digits = digits;
+    }
+
+    void number::shrink_to_fit()
+    {
+        if (m_digits == m_inline || m_capacity == m_size)
+            return;
+        limb_t * const digits = m_digits;
+        allocate(m_size);
+        for (int i = 0; i < m_size; ++i)
+            m_digits[i] = digits[i];
+        g_deallocate(digits);
     }
 
     void number::from_int(limb_t const * digits, int size)
     {
-        number result;
-        
-        result.m_size = size;
-        result.m_capacity = size;
-        result.m_negative = false;
-        result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
-        for (int i = 0; i < size; ++i)
-            result.m_digits[i] = digits[i];
-        *this = std::move(result);
+        assign(digits, size, false);
+    }
+
+    void number::divmod(number & quotient, number & remainder, number const & lhs, number const & rhs)
+    {
+        assert(&quotient != &remainder);
+        bool const quotient_negative = lhs.m_negative != rhs.m_negative;
+        bool const remainder_negative = lhs.m_negative;
+        if (&quotient != &lhs && &quotient != &rhs && &remainder != &lhs && &remainder != &rhs)
+        {
+            if (quotient.m_capacity < lhs.m_size)
+            {
+                int const capacity = std::max(lhs.m_size, quotient.m_capacity * 2);
+                quotient.deallocate();
+                quotient.allocate(capacity);
+            }
+            if (remainder.m_capacity < rhs.m_size)
+            {
+                int const capacity = std::max(rhs.m_size, remainder.m_capacity * 2);
+                remainder.deallocate();
+                remainder.allocate(capacity);
+            }
+            quotient.m_size = bigint::divmod(quotient.m_digits, remainder.m_digits, &remainder.m_size, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
+            quotient.m_negative = quotient_negative;
+            remainder.m_negative = remainder_negative;
+            return;
+        }
+
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+        limb_t * const quotient_digits = workspace.allocate(lhs.m_size);
+        limb_t * const remainder_digits = workspace.allocate(rhs.m_size);
+        int remainder_size;
+        int const quotient_size = bigint::divmod(quotient_digits, remainder_digits, &remainder_size, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
+        quotient.assign(quotient_digits, quotient_size, quotient_negative);
+        remainder.assign(remainder_digits, remainder_size, remainder_negative);
+        workspace.release(mark);
     }
 
     bool number::from_base10(char const * str, int length)
@@ -684,10 +4416,7 @@ namespace bigint
         }
         if (length <= 0)
             return false;
-        result.m_capacity = length / numerator;
-        if ((length % numerator) > 0)
-            result.m_capacity++;
-        result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
+        result.allocate((length + numerator - 1) / numerator);
         result.m_size = bigint::from_base10(result.m_digits, str, length);
         if (result.m_size > 0)
         {
@@ -709,10 +4438,7 @@ namespace bigint
         }
         if (length <= 0)
             return false;
-        result.m_capacity = length / (sizeof(limb_t) * 2);
-        if ((length % (sizeof(limb_t) * 2)) > 0)
-            result.m_capacity++;
-        result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
+        result.allocate((length + LIMB_HEX_CHARACTERS - 1) / LIMB_HEX_CHARACTERS);
         result.m_size = bigint::from_base16(result.m_digits, str, length);
         if (result.m_size > 0)
         {
@@ -774,106 +4500,556 @@ namespace bigint
         return compare(lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size) != 0;
     }
 
-    number operator+(number const & lhs, number const & rhs)
+    void number::add_signed(number & result, number const & lhs, number const & rhs, bool rhs_negative)
+    {
+        bool const lhs_negative = lhs.m_negative;
+        if (lhs_negative == rhs_negative)
+        {
+            // the digits are added in order, so result may share them with an operand, and result only grows past
+            // the longer operand when a carry comes out of its top limb
+            int const size = std::max(lhs.m_size, rhs.m_size);
+            int const shorter_size = std::min(lhs.m_size, rhs.m_size);
+            result.reserve(size);
+            limb_t const * const longer = lhs.m_size >= rhs.m_size ? lhs.m_digits : rhs.m_digits;
+            limb_t const * const shorter = lhs.m_size >= rhs.m_size ? rhs.m_digits : lhs.m_digits;
+            limb_t carry = add_limbs(result.m_digits, longer, shorter, shorter_size);
+            for (int i = shorter_size; i < size; ++i)
+            {
+                limb_t const digit = longer[i] + carry;
+                carry = (digit < carry) ? 1 : 0;
+                result.m_digits[i] = digit;
+            }
+            result.m_size = size;
+            result.m_negative = lhs_negative;
+            if (carry != 0)
+            {
+                result.reserve(size + 1);
+                result.m_digits[size] = carry;
+                result.m_size = size + 1;
+            }
+            return;
+        }
+        switch (compare(lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size))
+        {
+        case -1: // rhs > lhs
+            result.reserve(rhs.m_size);
+            result.m_size = bigint::sub(result.m_digits, rhs.m_digits, lhs.m_digits, rhs.m_size, lhs.m_size);
+            result.m_negative = rhs_negative;
+            break;
+        case 1: // lhs > rhs
+            result.reserve(lhs.m_size);
+            result.m_size = bigint::sub(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
+            result.m_negative = lhs_negative;
+            break;
+        default:
+            result.m_size = 1;
+            result.m_negative = false;
+            result.m_digits[0] = 0;
+            break;
+        }
+    }
+
+    // the other kernels must not write to their operands, the result goes through scratch memory when it is one of them
+    void number::compute(number & result, number const & lhs, number const & rhs, int capacity, bool negative, int (*operation)(limb_t *, limb_t const *, limb_t const *, int, int, scratch &))
+    {
+        scratch & workspace = thread_scratch();
+        if (&result != &lhs && &result != &rhs)
+        {
+            if (result.m_capacity < capacity)
+            {
+                int const grown = std::max(capacity, result.m_capacity * 2);
+                result.deallocate();
+                result.allocate(grown);
+            }
+            result.m_size = operation(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size, workspace);
+            result.m_negative = negative;
+            return;
+        }
+        // results that fit inline go through the stack, so small values do not need the scratch either
+        size_t const mark = workspace.mark();
+        limb_t local[INLINE_CAPACITY];
+        limb_t * const digits = capacity <= INLINE_CAPACITY ? local : workspace.allocate(capacity);
+        int const size = operation(digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size, workspace);
+        result.assign(digits, size, negative);
+        workspace.release(mark);
+    }
+
+    void add(number & result, number const & lhs, number const & rhs)
+    {
+        number::add_signed(result, lhs, rhs, rhs.m_negative);
+    }
+
+    void sub(number & result, number const & lhs, number const & rhs)
+    {
+        number::add_signed(result, lhs, rhs, !rhs.m_negative);
+    }
+
+    void mul(number & result, number const & lhs, number const & rhs)
+    {
+        number::compute(result, lhs, rhs, lhs.m_size + rhs.m_size, lhs.m_negative != rhs.m_negative, &mul_with_scratch);
+    }
+
+    void div(number & result, number const & lhs, number const & rhs)
+    {
+        number::compute(result, lhs, rhs, lhs.m_size, lhs.m_negative != rhs.m_negative, &div_with_scratch);
+    }
+
+    void mod(number & result, number const & lhs, number const & rhs)
+    {
+        number::compute(result, lhs, rhs, rhs.m_size, lhs.m_negative, &mod_with_scratch);
+    }
+
+    number powmod(number const & base, number const & exponent, number const & modulus)
+    {
+        assert(!exponent.m_negative);
+        number result;
+        result.allocate(modulus.m_size);
+        result.m_size = powmod(result.m_digits, base.m_digits, exponent.m_digits, modulus.m_digits, base.m_size, exponent.m_size, modulus.m_size);
+
+        // an odd power of a negative base is negative
+        if (base.m_negative && (*exponent.m_digits & 1) != 0 && !(result.m_size == 1 && *result.m_digits == 0))
+            result.m_size = bigint::sub(result.m_digits, modulus.m_digits, result.m_digits, modulus.m_size, result.m_size);
+        return result;
+    }
+
+    number gcd(number const & lhs, number const & rhs)
+    {
+        number result;
+        result.allocate(std::max(lhs.m_size, rhs.m_size));
+        result.m_size = gcd(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
+        return result;
+    }
+
+    number xgcd(number & lhs_cofactor, number & rhs_cofactor, number const & lhs, number const & rhs)
     {
         number result;
+        number cofactor;
+        result.allocate(std::max(lhs.m_size, rhs.m_size));
+        cofactor.allocate(rhs.m_size + 2);
+        bool cofactor_negative;
+        result.m_size = xgcd(result.m_digits, cofactor.m_digits, &cofactor.m_size, &cofactor_negative, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
 
-        if (lhs.m_negative == rhs.m_negative)
+        // |lhs| * cofactor = result (mod |rhs|), the other cofactor follows from an exact division
+        cofactor.m_negative = cofactor_negative != lhs.m_negative && !(cofactor.m_size == 1 && *cofactor.m_digits == 0);
+        number other;
+        if (!(rhs.m_size == 1 && *rhs.m_digits == 0))
         {
-            result.m_capacity = std::max(lhs.m_size, rhs.m_size) + 1;
-            result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
-            result.m_negative = lhs.m_negative;
-            result.m_size = add(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
+            mul(other, lhs, cofactor);
+            sub(other, result, other);
+            div(other, other, rhs);
         }
-        else
+        lhs_cofactor = std::move(cofactor);
+        rhs_cofactor = std::move(other);
+        return result;
+    }
+
+    bool modinv(number & result, number const & value, number const & modulus)
+    {
+        number inverse;
+        inverse.allocate(modulus.m_size);
+        inverse.m_size = modinv(inverse.m_digits, value.m_digits, modulus.m_digits, value.m_size, modulus.m_size);
+        if (inverse.m_size < 0)
+            return false;
+
+        // the inverse of a negative value is the opposite of the inverse of its magnitude
+        if (value.m_negative && !(inverse.m_size == 1 && *inverse.m_digits == 0))
+            inverse.m_size = bigint::sub(inverse.m_digits, modulus.m_digits, inverse.m_digits, modulus.m_size, inverse.m_size);
+        result = std::move(inverse);
+        return true;
+    }
+
+    number isqrt(number const & value)
+    {
+        return iroot(value, 2);
+    }
+
+    number iroot(number const & value, int k)
+    {
+        assert(!value.m_negative || (k & 1) != 0);
+        number result;
+        result.allocate((value.m_size + k - 1) / k);
+        result.m_size = iroot(result.m_digits, nullptr, nullptr, value.m_digits, value.m_size, k);
+        result.m_negative = value.m_negative;
+        return result;
+    }
+
+    number isqrt(number & remainder, number const & value)
+    {
+        return iroot(remainder, value, 2);
+    }
+
+    number iroot(number & remainder, number const & value, int k)
+    {
+        assert(!value.m_negative || (k & 1) != 0);
+        number result;
+        number rest;
+        result.allocate((value.m_size + k - 1) / k);
+        rest.allocate(value.m_size);
+        result.m_size = iroot(result.m_digits, rest.m_digits, &rest.m_size, value.m_digits, value.m_size, k);
+
+        // an odd root of a negative value is the opposite of the root of its magnitude, and so is the remainder
+        result.m_negative = value.m_negative;
+        rest.m_negative = value.m_negative && !(rest.m_size == 1 && *rest.m_digits == 0);
+        remainder = std::move(rest);
+        return result;
+    }
+
+    int number::product_tree(limb_t * result, number const * first, number const * last, scratch & workspace)
+    {
+        if (last - first == 1)
+        {
+            std::copy(first->m_digits, first->m_digits + first->m_size, result);
+            return first->m_size;
+        }
+        number const * const middle = first + (last - first) / 2;
+        int lhs_capacity = 0;
+        int rhs_capacity = 0;
+        for (number const * i = first; i != middle; ++i)
+            lhs_capacity += i->m_size;
+        for (number const * i = middle; i != last; ++i)
+            rhs_capacity += i->m_size;
+        size_t const mark = workspace.mark();
+        limb_t * const lhs = workspace.allocate(lhs_capacity);
+        limb_t * const rhs = workspace.allocate(rhs_capacity);
+        int const lhs_size = product_tree(lhs, first, middle, workspace);
+        int const rhs_size = product_tree(rhs, middle, last, workspace);
+        int const size = mul_with_scratch(result, lhs, rhs, lhs_size, rhs_size, workspace);
+        workspace.release(mark);
+        return size;
+    }
+
+    number product(number const * first, number const * last)
+    {
+        number result;
+        if (first == last)
+        {
+            *result.m_digits = 1;
+            return result;
+        }
+        int capacity = 0;
+        bool negative = false;
+        for (number const * i = first; i != last; ++i)
+        {
+            capacity += i->m_size;
+            negative = negative != i->m_negative;
+        }
+        result.allocate(capacity);
+        result.m_size = number::product_tree(result.m_digits, first, last, thread_scratch());
+        result.m_negative = negative && !(result.m_size == 1 && *result.m_digits == 0);
+        return result;
+    }
+
+    number factorial(int n)
+    {
+        assert(n >= 0);
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
+
+        // the odd parts of 2..n packed into limbs, their powers of two add up to a shift
+        limb_t * const factors = workspace.allocate(std::max(n, 1));
+        int count = 0;
+        int twos = 0;
+        for (int i = 2; i <= n; ++i)
         {
-            switch (compare(lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size))
+            limb_t odd = static_cast<limb_t>(i);
+            while ((odd & 1) == 0)
             {
-            case -1: // rhs > lhs
-                result.m_capacity = rhs.m_size;
-                result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
-                result.m_negative = rhs.m_negative;
-                result.m_size = sub(result.m_digits, rhs.m_digits, lhs.m_digits, rhs.m_size, lhs.m_size);
-                break;
-            case 1: // lhs > rhs
-                result.m_capacity = lhs.m_size;
-                result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
-                result.m_negative = lhs.m_negative;
-                result.m_size = sub(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
-                break;
-            default:
-                // result is already default initialized to zero
-                break;
+                odd >>= 1;
+                twos++;
             }
+            if (odd > 1)
+                pack_factor(factors, &count, odd);
         }
+
+        number result;
+        result.allocate(count + twos / static_cast<int>(sizeof(limb_t) * 8) + 2);
+        if (count > 0)
+            result.m_size = multiply_limbs(result.m_digits, factors, count, workspace);
+        else
+            *result.m_digits = 1;
+        result.m_size = shl(result.m_digits, result.m_digits, result.m_size, twos);
+        workspace.release(mark);
         return result;
     }
 
-    number operator-(number const & lhs, number const & rhs)
+    number binomial(int n, int k)
     {
+        assert(n >= 0);
         number result;
+        if (k < 0 || k > n)
+            return result;
+        k = std::min(k, n - k);
+        if (k == 0)
+        {
+            *result.m_digits = 1;
+            return result;
+        }
+        constexpr int limb_bits = sizeof(limb_t) * 8;
+        scratch & workspace = thread_scratch();
+        size_t const mark = workspace.mark();
 
-        if (lhs.m_negative != rhs.m_negative)
+        // sieve of the primes up to n, a set bit marks a composite
+        limb_t * const composite = workspace.allocate(n / limb_bits + 1);
+        std::fill(composite, composite + n / limb_bits + 1, 0);
+        for (int p = 2; p <= n / p; ++p)
         {
-            result.m_capacity = std::max(lhs.m_size, rhs.m_size) + 1;
-            result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
-            result.m_negative = lhs.m_negative;
-            result.m_size = add(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
+            if ((composite[p / limb_bits] >> (p % limb_bits) & 1) != 0)
+                continue;
+            for (int multiple = p * p; multiple <= n; multiple += p)
+                composite[multiple / limb_bits] |= static_cast<limb_t>(1) << (multiple % limb_bits);
         }
-        else
+
+        // by kummer's theorem p appears as many times as there are borrows subtracting k from n in base p, so every
+        // prime power is at most n
+        limb_t * const factors = workspace.allocate(n);
+        int count = 0;
+        for (int p = 2; p <= n; ++p)
         {
-            switch (compare(lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size))
+            if ((composite[p / limb_bits] >> (p % limb_bits) & 1) != 0)
+                continue;
+            int borrow = 0;
+            limb_t power = 1;
+            for (int lhs = n, rhs = k; lhs > 0; lhs /= p, rhs /= p)
             {
-            case -1: // rhs > lhs
-                result.m_capacity = rhs.m_size;
-                result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
-                result.m_negative = !rhs.m_negative;
-                result.m_size = sub(result.m_digits, rhs.m_digits, lhs.m_digits, rhs.m_size, lhs.m_size);
-                break;
-            case 1: // lhs > rhs
-                result.m_capacity = lhs.m_size;
-                result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
-                result.m_negative = lhs.m_negative;
-                result.m_size = sub(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
-                break;
-            default:
-                // result is already default initialized to zero
-                break;
+                borrow = lhs % p < rhs % p + borrow ? 1 : 0;
+                if (borrow != 0)
+                    power *= static_cast<limb_t>(p);
             }
+            if (power > 1)
+                pack_factor(factors, &count, power);
         }
+        result.allocate(count);
+        result.m_size = multiply_limbs(result.m_digits, factors, count, workspace);
+        workspace.release(mark);
         return result;
     }
 
-    number operator*(number const & lhs, number const & rhs)
+    number & number::operator<<=(int bits)
+    {
+        reserve(m_size + bits / static_cast<int>(sizeof(limb_t) * 8) + 1);
+        m_size = shl(m_digits, m_digits, m_size, bits);
+        return *this;
+    }
+
+    number & number::operator>>=(int bits)
+    {
+        m_size = shr(m_digits, m_digits, m_size, bits);
+        m_negative = m_negative && !(m_size == 1 && *m_digits == 0);
+        return *this;
+    }
+
+    void number::bitwise(number & result, number const & lhs, number const & rhs, int capacity, int (*operation)(limb_t *, limb_t const *, limb_t const *, int, int))
+    {
+        // the kernels go through the limbs in order, so result may share them with an operand
+        result.reserve(capacity);
+        result.m_size = operation(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
+        result.m_negative = false;
+    }
+
+    number & number::operator&=(number const & other)
+    {
+        bitwise(*this, *this, other, std::min(m_size, other.m_size), &bit_and);
+        return *this;
+    }
+
+    number & number::operator|=(number const & other)
+    {
+        bitwise(*this, *this, other, std::max(m_size, other.m_size), &bit_or);
+        return *this;
+    }
+
+    number & number::operator^=(number const & other)
+    {
+        bitwise(*this, *this, other, std::max(m_size, other.m_size), &bit_xor);
+        return *this;
+    }
+
+    int number::bit_length() const
+    {
+        return bigint::bit_length(m_digits, m_size);
+    }
+
+    bool number::test_bit(int bit) const
+    {
+        constexpr int limb_bits = sizeof(limb_t) * 8;
+        return bit / limb_bits < m_size && ((m_digits[bit / limb_bits] >> (bit % limb_bits)) & 1) != 0;
+    }
+
+    int number::popcount() const
+    {
+        int count = 0;
+        for (int i = 0; i < m_size; ++i)
+            count += limb_popcount(m_digits[i]);
+        return count;
+    }
+
+    number & number::operator+=(number const & other)
+    {
+        add(*this, *this, other);
+        return *this;
+    }
+
+    number & number::operator-=(number const & other)
+    {
+        sub(*this, *this, other);
+        return *this;
+    }
+
+    number & number::operator*=(number const & other)
+    {
+        mul(*this, *this, other);
+        return *this;
+    }
+
+    number & number::operator/=(number const & other)
+    {
+        div(*this, *this, other);
+        return *this;
+    }
+
+    number & number::operator%=(number const & other)
+    {
+        mod(*this, *this, other);
+        return *this;
+    }
+
+    number operator<<(number const & lhs, int bits)
     {
         number result;
+        result.allocate(lhs.m_size + bits / static_cast<int>(sizeof(limb_t) * 8) + 1);
+        result.m_size = shl(result.m_digits, lhs.m_digits, lhs.m_size, bits);
+        result.m_negative = lhs.m_negative;
+        return result;
+    }
 
-        result.m_capacity = lhs.m_size + rhs.m_size;
-        result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
-        result.m_negative = lhs.m_negative != rhs.m_negative;
-        result.m_size = mul(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
+    number operator>>(number const & lhs, int bits)
+    {
+        number result;
+        result.allocate(lhs.m_size);
+        result.m_size = shr(result.m_digits, lhs.m_digits, lhs.m_size, bits);
+        result.m_negative = lhs.m_negative && !(result.m_size == 1 && *result.m_digits == 0);
         return result;
     }
 
-    number operator/(number const & lhs, number const & rhs)
+    number operator&(number const & lhs, number const & rhs)
+    {
+        number result;
+        number::bitwise(result, lhs, rhs, std::min(lhs.m_size, rhs.m_size), &bit_and);
+        return result;
+    }
+
+    number operator|(number const & lhs, number const & rhs)
     {
         number result;
+        number::bitwise(result, lhs, rhs, std::max(lhs.m_size, rhs.m_size), &bit_or);
+        return result;
+    }
 
-        result.m_capacity = lhs.m_size;
-        result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
-        result.m_negative = lhs.m_negative != rhs.m_negative;
-        result.m_size = div(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
+    number operator^(number const & lhs, number const & rhs)
+    {
+        number result;
+        number::bitwise(result, lhs, rhs, std::max(lhs.m_size, rhs.m_size), &bit_xor);
         return result;
     }
 
-    number operator%(number const & lhs, number const & rhs)
+    number operator+(number const & lhs, number const & rhs)
     {
         number result;
+        add(result, lhs, rhs);
+        return result;
+    }
 
-        result.m_capacity = rhs.m_size;
-        result.m_digits = static_cast<limb_t *>(g_allocate(result.m_capacity * sizeof(limb_t)));
-        result.m_negative = lhs.m_negative;
-        result.m_size = mod(result.m_digits, lhs.m_digits, rhs.m_digits, lhs.m_size, rhs.m_size);
+    number operator+(number && lhs, number const & rhs)
+    {
+        add(lhs, lhs, rhs);
+        return std::move(lhs);
+    }
+
+    number operator+(number const & lhs, number && rhs)
+    {
+        add(rhs, lhs, rhs);
+        return std::move(rhs);
+    }
+
+    number operator+(number && lhs, number && rhs)
+    {
+        add(lhs, lhs, rhs);
+        return std::move(lhs);
+    }
+
+    number operator-(number const & lhs, number const & rhs)
+    {
+        number result;
+        sub(result, lhs, rhs);
+        return result;
+    }
+
+    number operator-(number && lhs, number const & rhs)
+    {
+        sub(lhs, lhs, rhs);
+        return std::move(lhs);
+    }
+
+    number operator-(number const & lhs, number && rhs)
+    {
+        sub(rhs, lhs, rhs);
+        return std::move(rhs);
+    }
+
+    number operator-(number && lhs, number && rhs)
+    {
+        sub(lhs, lhs, rhs);
+        return std::move(lhs);
+    }
+
+    number operator*(number const & lhs, number const & rhs)
+    {
+        number result;
+        mul(result, lhs, rhs);
+        return result;
+    }
+
+    number operator*(number && lhs, number const & rhs)
+    {
+        mul(lhs, lhs, rhs);
+        return std::move(lhs);
+    }
+
+    number operator*(number const & lhs, number && rhs)
+    {
+        mul(rhs, lhs, rhs);
+        return std::move(rhs);
+    }
+
+    number operator*(number && lhs, number && rhs)
+    {
+        mul(lhs, lhs, rhs);
+        return std::move(lhs);
+    }
+
+    number operator/(number const & lhs, number const & rhs)
+    {
+        number result;
+        div(result, lhs, rhs);
+        return result;
+    }
+
+    number operator/(number && lhs, number const & rhs)
+    {
+        div(lhs, lhs, rhs);
+        return std::move(lhs);
+    }
+
+    number operator%(number const & lhs, number const & rhs)
+    {
+        number result;
+        mod(result, lhs, rhs);
         return result;
     }
+
+    number operator%(number && lhs, number const & rhs)
+    {
+        mod(lhs, lhs, rhs);
+        return std::move(lhs);
+    }
 }
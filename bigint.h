@@ -1,15 +1,35 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <type_traits>
 
 namespace bigint
 {
+#if defined(BIGINT_LIMB_64)
+#if !defined(__SIZEOF_INT128__)
+#error "BIGINT_LIMB_64 requires a compiler providing unsigned __int128"
+#endif
+    // 64-bit limbs, BIGINT_LIMB_64 must be defined for every translation unit including bigint.h
+    using limb_t = ::uint64_t;
+    using limb_double_t = unsigned __int128;
+#else
     using limb_t = ::uint32_t;
     using limb_double_t = ::uint64_t;
+#endif
 
     // passing nullptr will set the allocator to malloc/free (the default allocator)
     void set_allocator(void * (*alloc)(size_t), void (*dealloc)(void *));
 
+    // multiplications split their sub-products across count threads, the calling thread being one of them
+    // a count of 1 or less disables the thread pool (the default), the allocator must be thread safe
+    // must not be called while another thread is doing arithmetic
+    void set_thread_count(int count);
+
+    // sub-products whose smaller operand has fewer limbs than size are not split across threads
+    // passing 0 restores the default grain size
+    void set_parallel_grain_size(int size);
+
     // returns the number of digits written, or -1 if an error occured
     // digits capcity must be big enough to store the result
     // slower than from_base16
@@ -20,12 +40,63 @@ namespace bigint
     int from_base16(limb_t * digits, char const * str, int length);
 
     // create a string representation of digits in base 10, returns the numbers of characters written in str
+    // when capacity is too small only the first capacity characters are written, the full length is still returned
     // slower than to_base16
     int to_base10(char * str, int capacity, limb_t const * digits, int size);
 
     // create a string representation of digits in base 16, returns the numbers of characters written in str
     int to_base16(char * str, int capacity, limb_t const * digits, int size);
 
+    // growable stack of temporary limbs: allocations are released together back to a mark and the memory is reused by
+    // later calls, it is only returned to the allocator by the destructor or trim
+    // a scratch must not be used by two threads at the same time, every thread has its own one used by default
+    class scratch
+    {
+    public:
+        scratch();
+        ~scratch();
+        scratch(scratch const &) = delete;
+        scratch & operator=(scratch const &) = delete;
+
+        // the memory stays valid until release is called with a mark taken before the allocation
+        limb_t * allocate(int size);
+        size_t mark() const;
+        void release(size_t mark);
+
+        // returns the memory above the current mark to the allocator
+        void trim();
+
+    private:
+        struct chunk;
+
+        chunk * m_first;
+        chunk * m_top;
+        size_t m_position;
+    };
+
+    // single limb divisor with a precomputed reciprocal, dividing by it takes multiplications instead of a hardware
+    // division per limb, which pays off when dividing several limbs by the same divisor
+    class limb_divisor
+    {
+    public:
+        // divisor must be greater than zero
+        explicit limb_divisor(limb_t divisor);
+
+        limb_t divisor() const;
+
+        // quotient capacity must be at least size, quotient can be digits
+        // returns the size of the quotient and writes the remainder
+        int divide(limb_t * quotient, limb_t const * digits, int size, limb_t * remainder) const;
+
+        limb_t mod(limb_t const * digits, int size) const;
+
+    private:
+        limb_t m_divisor;
+        limb_t m_normalized;
+        limb_t m_reciprocal;
+        int m_shift;
+    };
+
     // returns -1 if lhs < rhs, 1 if rhs > lhs, or 0 if lhs == rhs
     int compare(limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size);
 
@@ -38,10 +109,35 @@ namespace bigint
     // returns the size of the result
     int sub(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size);
 
+    // result capacity must be at least size + bits / limb bits + 1, result can be digits
+    // returns the size of the result
+    int shl(limb_t * result, limb_t const * digits, int size, int bits);
+
+    // result capacity must be at least size, result can be digits
+    // returns the size of the result
+    int shr(limb_t * result, limb_t const * digits, int size, int bits);
+
+    // result capacity must be at least min(lhs_size, rhs_size) for bit_and and max(lhs_size, rhs_size) for the others
+    // result can be lhs or rhs, returns the size of the result
+    int bit_and(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size);
+    int bit_or(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size);
+    int bit_xor(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size);
+
+    // returns the number of bits without the leading zeros, 0 for zero
+    int bit_length(limb_t const * digits, int size);
+
     // result capacity must be at least lhs_size + rhs_size
     // returns the size of the result
     int mul(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size);
 
+    // same as mul, taking its temporary memory from workspace
+    int mul_with_scratch(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, scratch & workspace);
+
+    // result capacity must be at least size * 2
+    // faster than mul, which calls it when lhs and rhs are the same
+    // returns the size of the result
+    int sqr(limb_t * result, limb_t const * digits, int size);
+
     // result capacity must be at least lhs_size
     // rhs must be greater than zero
     // returns the size of the result
@@ -52,17 +148,110 @@ namespace bigint
     // returns the size of the result
     int mod(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size);
 
+    // quotient capacity must be at least lhs_size and remainder capacity at least rhs_size
+    // rhs must be greater than zero
+    // computes both in a single division, returns the size of the quotient and writes the size of the remainder
+    int divmod(limb_t * quotient, limb_t * remainder, int * remainder_size, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size);
+
+    // same as div and mod, taking their temporary memory from workspace
+    int div_with_scratch(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, scratch & workspace);
+    int mod_with_scratch(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size, scratch & workspace);
+
+    // result capacity must be at least size + 2
+    // digits must be greater than zero
+    // computes base^(size * 2) / digits rounded down, base being 2^(limb bits), by newton iteration
+    // returns the size of the result
+    int inverse(limb_t * result, limb_t const * digits, int size);
+
+    // result capacity must be at least max(lhs_size, rhs_size)
+    // computes the gcd by lehmer steps on the two high limbs, through a half gcd for the biggest values
+    // gcd(0, 0) is 0, returns the size of the result
+    int gcd(limb_t * result, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size);
+
+    // same as gcd, cofactor capacity must be at least rhs_size + 2
+    // writes the cofactor with lhs * cofactor = result (mod rhs), whose magnitude is at most rhs, along with its size
+    // and its sign, a zero rhs gives a cofactor of one
+    int xgcd(limb_t * result, limb_t * cofactor, int * cofactor_size, bool * cofactor_negative, limb_t const * lhs, limb_t const * rhs, int lhs_size, int rhs_size);
+
+    // result capacity must be at least modulus_size
+    // modulus must be greater than zero
+    // returns the size of the inverse of digits modulo modulus, in [0, modulus), or -1 when they are not coprime
+    int modinv(limb_t * result, limb_t const * digits, limb_t const * modulus, int size, int modulus_size);
+
+    // result capacity must be at least (size + 1) / 2 and remainder capacity, unless it is nullptr, at least size
+    // computes the square root rounded down by newton iteration from a floating point estimate of the high limbs,
+    // doubling the precision at each step, and writes digits - result^2 to remainder along with its size
+    // returns the size of the result
+    int isqrt(limb_t * result, limb_t * remainder, int * remainder_size, limb_t const * digits, int size);
+
+    // same as isqrt for the k-th root, k must be greater than zero and result capacity at least (size + k - 1) / k
+    int iroot(limb_t * result, limb_t * remainder, int * remainder_size, limb_t const * digits, int size, int k);
+
+    // residues modulo an odd modulus kept in montgomery form, digits * base^size mod modulus, so that products are reduced
+    // without division, every value is size limbs below the modulus and the context preallocates the temporary memory
+    // a context must not be used by two threads at the same time
+    class montgomery
+    {
+    public:
+        // modulus must be odd, greater than one and trimmed
+        montgomery(limb_t const * modulus, int size);
+        ~montgomery();
+        montgomery(montgomery const &) = delete;
+        montgomery & operator=(montgomery const &) = delete;
+
+        int size() const;
+
+        // result capacity must be at least size, digits can be any value
+        void to_montgomery(limb_t * result, limb_t const * digits, int size);
+
+        // result capacity must be at least size, result can be digits
+        // returns the size of the result
+        int from_montgomery(limb_t * result, limb_t const * digits);
+
+        // result can be lhs or rhs
+        void mul(limb_t * result, limb_t const * lhs, limb_t const * rhs);
+
+        // takes base in normal form, result capacity must be at least size
+        // returns the size of the result, in normal form
+        int pow(limb_t * result, limb_t const * base, limb_t const * exponent, int base_size, int exponent_size);
+
+    private:
+        int m_size;
+        limb_t m_inverse;
+        limb_t * m_modulus;
+        limb_t * m_r2;
+        limb_t * m_work;
+    };
+
+    // result capacity must be at least modulus_size
+    // modulus must be greater than zero, odd ones use montgomery multiplications
+    // returns the size of the result
+    int powmod(limb_t * result, limb_t const * base, limb_t const * exponent, limb_t const * modulus, int base_size, int exponent_size, int modulus_size);
+
+    template <int Bits>
+    class fixed;
+
     class number
     {
     public:
         number();
+        // the fixed width value, which is never negative
+        template <int Bits>
+        number(fixed<Bits> const & value);
         number(number const & other);
         number(number && other);
         number & operator=(number const & other);
         number & operator=(number && other);
         ~number();
 
+        // capacity grows geometrically and is kept by assignments and compound operators, reserve never shrinks it
+        void reserve(int capacity);
+        void shrink_to_fit();
+
         void from_int(limb_t const * digits, int size);
+
+        // quotient and remainder must be different numbers, either can be lhs or rhs
+        static void divmod(number & quotient, number & remainder, number const & lhs, number const & rhs);
         bool from_base10(char const * str, int length);
         bool from_base16(char const * str, int length);
         int to_base10(char * str, int capacity);
@@ -75,16 +264,415 @@ namespace bigint
         friend bool operator==(number const & lhs, number const & rhs);
         friend bool operator!=(number const & lhs, number const & rhs);
 
+        number & operator+=(number const & other);
+        number & operator-=(number const & other);
+        number & operator*=(number const & other);
+        number & operator/=(number const & other);
+        number & operator%=(number const & other);
+
+        // shifts and bitwise operations work on the magnitudes, shifts keep the sign and the others give a positive result
+        number & operator<<=(int bits);
+        number & operator>>=(int bits);
+        number & operator&=(number const & other);
+        number & operator|=(number const & other);
+        number & operator^=(number const & other);
+
+        // number of bits of the magnitude, 0 for zero
+        int bit_length() const;
+        bool test_bit(int bit) const;
+        int popcount() const;
+
+        // rvalue operands are reused for the result
         friend number operator+(number const & lhs, number const & rhs);
+        friend number operator+(number && lhs, number const & rhs);
+        friend number operator+(number const & lhs, number && rhs);
+        friend number operator+(number && lhs, number && rhs);
         friend number operator-(number const & lhs, number const & rhs);
+        friend number operator-(number && lhs, number const & rhs);
+        friend number operator-(number const & lhs, number && rhs);
+        friend number operator-(number && lhs, number && rhs);
         friend number operator*(number const & lhs, number const & rhs);
+        friend number operator*(number && lhs, number const & rhs);
+        friend number operator*(number const & lhs, number && rhs);
+        friend number operator*(number && lhs, number && rhs);
         friend number operator/(number const & lhs, number const & rhs);
+        friend number operator/(number && lhs, number const & rhs);
         friend number operator%(number const & lhs, number const & rhs);
+        friend number operator%(number && lhs, number const & rhs);
+
+        friend number operator<<(number const & lhs, int bits);
+        friend number operator>>(number const & lhs, int bits);
+        friend number operator&(number const & lhs, number const & rhs);
+        friend number operator|(number const & lhs, number const & rhs);
+        friend number operator^(number const & lhs, number const & rhs);
+
+        friend number powmod(number const & base, number const & exponent, number const & modulus);
+        friend number gcd(number const & lhs, number const & rhs);
+        friend number xgcd(number & lhs_cofactor, number & rhs_cofactor, number const & lhs, number const & rhs);
+        friend bool modinv(number & result, number const & value, number const & modulus);
+        friend number iroot(number const & value, int k);
+        friend number iroot(number & remainder, number const & value, int k);
+        friend number product(number const * first, number const * last);
+        friend number factorial(int n);
+        friend number binomial(int n, int k);
+        friend class reducer;
+        template <int Bits>
+        friend class fixed;
+
+        friend void add(number & result, number const & lhs, number const & rhs);
+        friend void sub(number & result, number const & lhs, number const & rhs);
+        friend void mul(number & result, number const & lhs, number const & rhs);
+        friend void div(number & result, number const & lhs, number const & rhs);
+        friend void mod(number & result, number const & lhs, number const & rhs);
 
     private:
+        // small magnitudes are stored in m_inline, m_digits only points to the heap once they outgrow it
+        // 8 limbs hold the product of two 4 limb values, so arithmetic on values of up to 4 limbs never allocates
+        static constexpr int INLINE_CAPACITY = 8;
+
+        void allocate(int capacity);
+        void deallocate();
+        void assign(limb_t const * digits, int size, bool negative);
+        static void add_signed(number & result, number const & lhs, number const & rhs, bool rhs_negative);
+        static void compute(number & result, number const & lhs, number const & rhs, int capacity, bool negative, int (*operation)(limb_t *, limb_t const *, limb_t const *, int, int, scratch &));
+        static void bitwise(number & result, number const & lhs, number const & rhs, int capacity, int (*operation)(limb_t *, limb_t const *, limb_t const *, int, int));
+        static int product_tree(limb_t * result, number const * first, number const * last, scratch & workspace);
+
         int m_size;
         int m_capacity;
         bool m_negative;
         limb_t * m_digits;
+        limb_t m_inline[INLINE_CAPACITY];
     };
+
+    // same as the operators, writing to result which can be one of the operands and keeps its capacity
+    void add(number & result, number const & lhs, number const & rhs);
+    void sub(number & result, number const & lhs, number const & rhs);
+    void mul(number & result, number const & lhs, number const & rhs);
+    void div(number & result, number const & lhs, number const & rhs);
+    void mod(number & result, number const & lhs, number const & rhs);
+
+    // exponent must not be negative, the result is in [0, |modulus|)
+    number powmod(number const & base, number const & exponent, number const & modulus);
+
+    // the gcd of the magnitudes, never negative
+    number gcd(number const & lhs, number const & rhs);
+
+    // returns the gcd and writes the cofactors with lhs * lhs_cofactor + rhs * rhs_cofactor = gcd, the cofactors can be
+    // lhs or rhs
+    number xgcd(number & lhs_cofactor, number & rhs_cofactor, number const & lhs, number const & rhs);
+
+    // result = value^-1 mod modulus in [0, |modulus|), returns false and leaves result unchanged when value and
+    // modulus are not coprime
+    bool modinv(number & result, number const & value, number const & modulus);
+
+    // roots rounded toward zero, value must not be negative unless k is odd, the root of a negative value being the
+    // opposite of the root of its magnitude, k must be greater than zero
+    number isqrt(number const & value);
+    number iroot(number const & value, int k);
+
+    // same as isqrt and iroot, also writing value - root^k, which has the sign of value, remainder can be value
+    number isqrt(number & remainder, number const & value);
+    number iroot(number & remainder, number const & value, int k);
+
+    // product of [first, last), one when the range is empty, multiplying the halves of the range recursively so that
+    // the operands of every multiplication have similar sizes instead of growing one factor at a time
+    number product(number const * first, number const * last);
+
+    // n must not be negative, the odd parts of the factors are multiplied by a product tree and the powers of two shifted
+    number factorial(int n);
+
+    // n must not be negative, zero when k is negative or above n, multiplies the prime powers dividing the result
+    number binomial(int n, int k);
+
+    // unsigned integer of Bits bits, Bits being a multiple of the limb bits, whose limbs live inline so that it never
+    // allocates, the arithmetic wraps around modulo 2^Bits and its kernels are unrolled at compile time by template
+    // recursion, every operation being constexpr
+    template <int Bits>
+    class fixed
+    {
+    public:
+        static constexpr int SIZE = Bits / static_cast<int>(sizeof(limb_t) * 8);
+        static_assert(Bits > 0 && Bits % static_cast<int>(sizeof(limb_t) * 8) == 0, "Bits must be a positive multiple of the limb bits");
+
+        constexpr fixed()
+            : m_digits()
+        {
+        }
+
+        constexpr explicit fixed(limb_t value)
+            : m_digits()
+        {
+            m_digits[0] = value;
+        }
+
+        // the value modulo 2^Bits, negative values wrapping around like unsigned integers
+        explicit fixed(number const & value)
+            : m_digits()
+        {
+            from_int(value.m_digits, value.m_size);
+            if (value.m_negative)
+                *this = fixed() - *this;
+        }
+
+        // keeps the low SIZE limbs of digits
+        constexpr void from_int(limb_t const * digits, int size)
+        {
+            for (int i = 0; i < SIZE; ++i)
+                m_digits[i] = i < size ? digits[i] : 0;
+        }
+
+        constexpr limb_t * digits()
+        {
+            return m_digits;
+        }
+
+        constexpr limb_t const * digits() const
+        {
+            return m_digits;
+        }
+
+        constexpr fixed & operator+=(fixed const & other)
+        {
+            add_digits(m_digits, other.m_digits, 0, std::integral_constant<int, 0>());
+            return *this;
+        }
+
+        constexpr fixed & operator-=(fixed const & other)
+        {
+            sub_digits(m_digits, other.m_digits, 0, std::integral_constant<int, 0>());
+            return *this;
+        }
+
+        constexpr fixed & operator*=(fixed const & other)
+        {
+            // both operands are copied before the reset, other can be *this
+            fixed const lhs = *this;
+            fixed const rhs = other;
+            *this = fixed();
+            mul_rows<SIZE, 0>(m_digits, lhs.m_digits, rhs.m_digits, std::true_type());
+            return *this;
+        }
+
+        friend constexpr fixed operator+(fixed lhs, fixed const & rhs)
+        {
+            return lhs += rhs;
+        }
+
+        friend constexpr fixed operator-(fixed lhs, fixed const & rhs)
+        {
+            return lhs -= rhs;
+        }
+
+        friend constexpr fixed operator*(fixed lhs, fixed const & rhs)
+        {
+            return lhs *= rhs;
+        }
+
+        // the whole product, without wrapping around
+        friend constexpr fixed<Bits * 2> mul_wide(fixed const & lhs, fixed const & rhs)
+        {
+            fixed<Bits * 2> result;
+            mul_rows<SIZE * 2, 0>(result.digits(), lhs.m_digits, rhs.m_digits, std::true_type());
+            return result;
+        }
+
+        // returns -1 if lhs < rhs, 1 if lhs > rhs, or 0 if lhs == rhs
+        friend constexpr int compare(fixed const & lhs, fixed const & rhs)
+        {
+            return compare_digits(lhs.m_digits, rhs.m_digits, std::integral_constant<int, SIZE - 1>());
+        }
+
+        friend constexpr bool operator<(fixed const & lhs, fixed const & rhs)
+        {
+            return compare(lhs, rhs) < 0;
+        }
+
+        friend constexpr bool operator>(fixed const & lhs, fixed const & rhs)
+        {
+            return compare(lhs, rhs) > 0;
+        }
+
+        friend constexpr bool operator<=(fixed const & lhs, fixed const & rhs)
+        {
+            return compare(lhs, rhs) <= 0;
+        }
+
+        friend constexpr bool operator>=(fixed const & lhs, fixed const & rhs)
+        {
+            return compare(lhs, rhs) >= 0;
+        }
+
+        friend constexpr bool operator==(fixed const & lhs, fixed const & rhs)
+        {
+            return compare(lhs, rhs) == 0;
+        }
+
+        friend constexpr bool operator!=(fixed const & lhs, fixed const & rhs)
+        {
+            return compare(lhs, rhs) != 0;
+        }
+
+    private:
+        static constexpr int LIMB_BITS = static_cast<int>(sizeof(limb_t) * 8);
+
+        // digits += other from limb I up, returns the carry out of the top limb
+        template <int I>
+        static constexpr limb_t add_digits(limb_t * digits, limb_t const * other, limb_t carry, std::integral_constant<int, I>)
+        {
+            limb_double_t const sum = static_cast<limb_double_t>(digits[I]) + other[I] + carry;
+            digits[I] = static_cast<limb_t>(sum);
+            return add_digits(digits, other, static_cast<limb_t>(sum >> LIMB_BITS), std::integral_constant<int, I + 1>());
+        }
+
+        static constexpr limb_t add_digits(limb_t *, limb_t const *, limb_t carry, std::integral_constant<int, SIZE>)
+        {
+            return carry;
+        }
+
+        // digits -= other from limb I up, the borrow is the low bit of the high half of the double width difference
+        template <int I>
+        static constexpr limb_t sub_digits(limb_t * digits, limb_t const * other, limb_t borrow, std::integral_constant<int, I>)
+        {
+            limb_double_t const difference = static_cast<limb_double_t>(digits[I]) - other[I] - borrow;
+            digits[I] = static_cast<limb_t>(difference);
+            return sub_digits(digits, other, static_cast<limb_t>(difference >> LIMB_BITS) & 1, std::integral_constant<int, I + 1>());
+        }
+
+        static constexpr limb_t sub_digits(limb_t *, limb_t const *, limb_t borrow, std::integral_constant<int, SIZE>)
+        {
+            return borrow;
+        }
+
+        // result[I + J] += lhs[I] * rhs[J] from J up, the N limbs of result being enough for the product or keeping its
+        // low limbs, the carry out of a whole row lands on the limb above it, which no earlier row has reached
+        template <int N, int I, int J>
+        static constexpr void mul_row(limb_t * result, limb_t const * lhs, limb_t const * rhs, limb_t carry, std::true_type)
+        {
+            limb_double_t const product = static_cast<limb_double_t>(lhs[I]) * rhs[J] + result[I + J] + carry;
+            result[I + J] = static_cast<limb_t>(product);
+            mul_row<N, I, J + 1>(result, lhs, rhs, static_cast<limb_t>(product >> LIMB_BITS), std::integral_constant<bool, (J + 1 < SIZE && I + J + 1 < N)>());
+        }
+
+        template <int N, int I, int J>
+        static constexpr void mul_row(limb_t * result, limb_t const *, limb_t const *, limb_t carry, std::false_type)
+        {
+            if (J == SIZE && I + J < N)
+                result[I + J] = carry;
+        }
+
+        // result must be zero
+        template <int N, int I>
+        static constexpr void mul_rows(limb_t * result, limb_t const * lhs, limb_t const * rhs, std::true_type)
+        {
+            mul_row<N, I, 0>(result, lhs, rhs, 0, std::true_type());
+            mul_rows<N, I + 1>(result, lhs, rhs, std::integral_constant<bool, (I + 1 < SIZE && I + 1 < N)>());
+        }
+
+        template <int N, int I>
+        static constexpr void mul_rows(limb_t *, limb_t const *, limb_t const *, std::false_type)
+        {
+        }
+
+        // from limb I down
+        template <int I>
+        static constexpr int compare_digits(limb_t const * lhs, limb_t const * rhs, std::integral_constant<int, I>)
+        {
+            return lhs[I] != rhs[I] ? (lhs[I] < rhs[I] ? -1 : 1) : compare_digits(lhs, rhs, std::integral_constant<int, I - 1>());
+        }
+
+        static constexpr int compare_digits(limb_t const *, limb_t const *, std::integral_constant<int, -1>)
+        {
+            return 0;
+        }
+
+        limb_t m_digits[SIZE];
+    };
+
+    template <int Bits>
+    number::number(fixed<Bits> const & value)
+        : number()
+    {
+        int size = fixed<Bits>::SIZE;
+        while (size > 1 && value.digits()[size - 1] == 0)
+            size--;
+        from_int(value.digits(), size);
+    }
+
+    // remainders of many values by the same modulus, normalized once along with a barrett reciprocal used for big moduli,
+    // values of up to twice the size of the modulus are reduced without allocating, the modulus can be even
+    // a reducer must not be used by two threads at the same time
+    class reducer
+    {
+    public:
+        // modulus must be greater than zero and trimmed
+        reducer(limb_t const * modulus, int size);
+        // the sign of modulus is ignored
+        explicit reducer(number const & modulus);
+        ~reducer();
+        reducer(reducer const &) = delete;
+        reducer & operator=(reducer const &) = delete;
+
+        int size() const;
+
+        // result capacity must be at least size, result can be digits
+        // returns the size of the result
+        int reduce(limb_t * result, limb_t const * digits, int size);
+
+        // same as value % modulus, result can be value
+        void reduce(number & result, number const & value);
+
+    private:
+        void init(limb_t const * modulus, int size);
+
+        limb_divisor m_divisor;
+        int m_size;
+        int m_shift;
+        limb_t * m_modulus;
+        limb_t * m_normalized;
+        limb_t * m_reciprocal;
+        limb_t * m_product;
+        limb_t * m_quotient;
+        limb_t * m_lhs;
+        limb_t * m_memory;
+    };
+
+    // count numbers of size limbs each in structure of arrays layout, limb i of number j being at digits()[i * count + j],
+    // so that the batch operations below run the same limb of consecutive numbers in simd lanes, with avx2 kernels
+    // selected at runtime on x86-64, the numbers start at zero
+    class batch
+    {
+    public:
+        // count and size must be greater than zero
+        batch(int count, int size);
+        ~batch();
+        batch(batch const &) = delete;
+        batch & operator=(batch const &) = delete;
+
+        int count() const;
+        int size() const;
+        limb_t * digits();
+        limb_t const * digits() const;
+
+        // copies number index from or to limbs in the usual layout, set zero extends digits, which must not have
+        // more than size limbs, get writes size limbs
+        void set(int index, limb_t const * digits, int size);
+        void get(int index, limb_t * digits) const;
+
+    private:
+        int m_count;
+        int m_size;
+        limb_t * m_digits;
+    };
+
+    // lhs and rhs must have the same count and size, result the same count, result can be lhs or rhs
+    // add and sub work modulo base^size, a result with size + 1 limbs gets the carry, or the borrow, in its top limb
+    void add(batch & result, batch const & lhs, batch const & rhs);
+    void sub(batch & result, batch const & lhs, batch const & rhs);
+
+    // result size must be at most lhs size * 2, the products are taken modulo base^(result size)
+    void mul(batch & result, batch const & lhs, batch const & rhs);
+
+    // results capacity must be at least count, writes -1, 0 or 1 as compare does for every number
+    void compare(int * results, batch const & lhs, batch const & rhs);
 }
@@ -0,0 +1,73 @@
+// checks fixed in constant expressions, including operators whose operands are the same object, and at run time
+// against number
+
+#include <cstdio>
+#include "../bigint.h"
+
+namespace
+{
+    using bigint::fixed;
+    using bigint::limb_t;
+
+    template <int Bits>
+    constexpr fixed<Bits> square_double_cancel(limb_t value)
+    {
+        fixed<Bits> x(value);
+        x *= x;
+        x += x;
+        x -= x;
+        x += fixed<Bits>(value);
+        x *= x;
+        return x;
+    }
+
+    constexpr limb_t MAX_LIMB = ~static_cast<limb_t>(0);
+
+    static_assert(square_double_cancel<128>(7) == fixed<128>(49), "aliased operands");
+    static_assert(square_double_cancel<256>(MAX_LIMB) == fixed<256>(MAX_LIMB) * fixed<256>(MAX_LIMB), "aliased operands");
+    static_assert(fixed<128>() - fixed<128>(1) > fixed<128>(MAX_LIMB), "wraps modulo 2^Bits");
+    static_assert(mul_wide(fixed<128>(MAX_LIMB), fixed<128>(MAX_LIMB)) == fixed<256>(MAX_LIMB) * fixed<256>(MAX_LIMB), "mul_wide");
+
+    int g_failures = 0;
+
+    void check(bool condition, char const * what)
+    {
+        if (!condition)
+        {
+            std::printf("failed: %s\n", what);
+            g_failures++;
+        }
+    }
+
+    template <int Bits>
+    void check_against_number()
+    {
+        fixed<Bits> x;
+        for (int i = 0; i < fixed<Bits>::SIZE; ++i)
+            x.digits()[i] = MAX_LIMB - static_cast<limb_t>(i * 12345);
+        bigint::number const value(x);
+
+        fixed<Bits> square = x;
+        square *= square;
+        check(square == fixed<Bits>(value * value), "x *= x");
+        check(bigint::number(mul_wide(x, x)) == value * value, "mul_wide");
+
+        fixed<Bits> twice = x;
+        twice += twice;
+        check(twice == fixed<Bits>(value + value), "x += x");
+
+        fixed<Bits> zero = x;
+        zero -= zero;
+        check(zero == fixed<Bits>(), "x -= x");
+
+        check(fixed<Bits>(bigint::number() - value) + x == fixed<Bits>(), "negative values wrap");
+    }
+}
+
+int main()
+{
+    check_against_number<128>();
+    check_against_number<256>();
+    check_against_number<512>();
+    return g_failures == 0 ? 0 : 1;
+}